@@ -1,6 +1,8 @@
 #include "app.hpp"
+#include "upload_batcher.hpp"
 
 #include <stdexcept>
+#include <iostream>
 #include <array>
 #include <sstream>
 #include <iomanip>
@@ -18,7 +20,20 @@ namespace rub
 		std::shared_ptr<Camera> camera = std::make_shared<Camera>(window, 70);
 		camera->setPosition(glm::vec3(0, 0, -3.0f));
 
-		scene = std::make_unique<Scene>(device, renderer.getSwapChain(), camera, "textures/spruit_sunrise_2k.exr", renderObjects);
+		//Past this point even sorted CPU recording scales with object count, so let the GPU cull and build the draws
+		Scene::DrawPath drawPath = renderObjects.size() >= GPU_DRIVEN_THRESHOLD ? Scene::DrawPath::GpuDriven : Scene::DrawPath::Direct;
+		scene = std::make_unique<Scene>(device, renderer.getSwapChain(), threadPool, geometryArena, camera, "textures/spruit_sunrise_2k.exr", renderObjects, drawPath);
+		//Splitting a handful of draws across threads costs more than it saves
+		if (renderObjects.size() >= PARALLEL_RECORDING_THRESHOLD)
+		{
+			scene->setRecordingMode(Scene::RecordingMode::Parallel);
+		}
+
+		//Anything loaded since the last one-off submit still has to reach the GPU before the first frame reads it
+		UploadBatcher& uploadBatcher = device.getUploadBatcher();
+		uploadBatcher.flush();
+		std::cout << "Uploaded " << std::fixed << std::setprecision(1) << uploadBatcher.getUploadedBytes() / (1024.0 * 1024.0) << "MB in "
+			<< uploadBatcher.getSubmitCount() << " submits on the " << (uploadBatcher.hasDedicatedTransferQueue() ? "transfer" : "graphics") << " queue" << std::endl;
 
 		VkRenderPass renderPass = renderer.getRenderPass();
 
@@ -32,15 +47,23 @@ namespace rub
 			camera->updatePosition(window);
 			camera->updateRotation(window);
 
+			//Anything decoded or created since the last frame starts copying while this one renders
+			assetManager.update();
+			uploadBatcher.flush();
+
 			double cpuTime = 0;
 
 			auto commandBuffer = renderer.beginFrame();
+			//Meshes freed a few frames ago are no longer in use once the fence has been waited on
+			geometryArena.beginFrame(renderer.getFrameCount(), renderer.getCompletedFrameCount());
 			if (commandBuffer != nullptr)
 			{
 				using namespace std::chrono;
 				
 				auto cpuTime1 = high_resolution_clock::now();
-				renderer.beginRenderPass(commandBuffer);
+				scene->update(renderer.getFrameIndex());
+				scene->cull(commandBuffer);
+				renderer.beginRenderPass(commandBuffer, scene->getSubpassContents());
 				scene->draw(commandBuffer, renderPass);
 				renderer.endRenderPass(commandBuffer);
 				auto cpuTime2 = high_resolution_clock::now();
@@ -57,7 +80,9 @@ namespace rub
 			  // printf and reset timer
 				//printf("%f ms/frame\n", 1000.0 / double(nbFrames));
 				std::stringstream suffix;
-				suffix << std::fixed << std::setprecision(3) << 1000.0 / double(nbFrames) << "ms - CPU Time: " << cpuTime << "ms";
+				suffix << std::fixed << std::setprecision(3) << 1000.0 / double(nbFrames) << "ms - CPU Time: " << cpuTime << "ms - GPU Time: " << renderer.getGpuTime() << "ms"
+					<< " - Draws: " << scene->getDrawStats().drawCount << " - Culled: " << scene->getDrawStats().culledCount << " - Binds: " << scene->getDrawStats().bindsIssued << " issued, " << scene->getDrawStats().bindsSkipped << " skipped"
+					<< " - Upload: " << std::setprecision(1) << scene->getUploadBytes() / 1024.0 << "KB";
 				window.changeTitleSuffix(suffix.str());
 
 				nbFrames = 0;
@@ -73,19 +98,19 @@ namespace rub
 		//std::shared_ptr<Model> suzanne = std::make_shared<Model>(device, "models/suzanne_2.obj");
 		//std::shared_ptr<Model> triangle = std::make_shared<Model>(device, "models/triangle.obj");
 		//std::shared_ptr<Model> cube = std::make_shared<Model>(device, "models/cube.obj");
-		std::shared_ptr<Model> sphere = std::make_shared<Model>(device, "models/sphere.obj");
+		std::shared_ptr<Model> sphere = assetManager.loadModel("models/sphere.obj");
 
-		std::shared_ptr<Texture> blueWallAlbedo = std::make_shared<Texture>(device, "textures/PaintedBricks001_1K_Color.png", Texture::Format::SRGB);
-		std::shared_ptr<Texture> blueWallNormal = std::make_shared<Texture>(device, "textures/PaintedBricks001_1K_Normal.png", Texture::Format::LINEAR);
-		std::shared_ptr<Texture> blueWallMask = std::make_shared<Texture>(device, "textures/PaintedBricks001_1K_Mask.png", Texture::Format::LINEAR);
+		std::shared_ptr<Texture> blueWallAlbedo = assetManager.loadTexture("textures/PaintedBricks001_1K_Color.png", Texture::Format::SRGB);
+		std::shared_ptr<Texture> blueWallNormal = assetManager.loadTexture("textures/PaintedBricks001_1K_Normal.png", Texture::Format::LINEAR);
+		std::shared_ptr<Texture> blueWallMask = assetManager.loadTexture("textures/PaintedBricks001_1K_Mask.png", Texture::Format::LINEAR);
 
 		//std::shared_ptr<Texture> brickWallAlbedo = std::make_shared<Texture>(device, "textures/Bricks071_1K_Color.png", Texture::Format::SRGB);
 		//std::shared_ptr<Texture> brickWallNormal = std::make_shared<Texture>(device, "textures/Bricks071_1K_Normal.png", Texture::Format::LINEAR);
 		//std::shared_ptr<Texture> brickWallMask = std::make_shared<Texture>(device, "textures/Bricks071_1K_Roughness.png", Texture::Format::LINEAR);
 
-		std::shared_ptr<Texture> metalAlbedo = std::make_shared<Texture>(device, "textures/Metal011_1K_Color.png", Texture::Format::SRGB);
-		std::shared_ptr<Texture> metalNormal = std::make_shared<Texture>(device, "textures/Metal011_1K_NormalGL.png", Texture::Format::LINEAR);
-		std::shared_ptr<Texture> metalMask = std::make_shared<Texture>(device, "textures/Metal011_1K_Mask.png", Texture::Format::LINEAR);
+		std::shared_ptr<Texture> metalAlbedo = assetManager.loadTexture("textures/Metal011_1K_Color.png", Texture::Format::SRGB);
+		std::shared_ptr<Texture> metalNormal = assetManager.loadTexture("textures/Metal011_1K_NormalGL.png", Texture::Format::LINEAR);
+		std::shared_ptr<Texture> metalMask = assetManager.loadTexture("textures/Metal011_1K_Mask.png", Texture::Format::LINEAR);
 
 		std::shared_ptr<Material> blueWallMaterial = std::make_shared<Material>(device, "shaders/pbr.vert.spv", "shaders/pbr.frag.spv");
 		blueWallMaterial->addTexture(blueWallAlbedo);
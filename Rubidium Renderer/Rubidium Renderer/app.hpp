@@ -8,6 +8,8 @@
 #include "renderer.hpp"
 #include "texture.hpp"
 #include "scene.hpp"
+#include "thread_pool.hpp"
+#include "asset_manager.hpp"
 
 #include <memory>
 #include <vector>
@@ -20,6 +22,8 @@ namespace rub
 	public:
 		static constexpr int WIDTH = 1280;
 		static constexpr int HEIGHT = 720;
+		static constexpr size_t PARALLEL_RECORDING_THRESHOLD = 256;
+		static constexpr size_t GPU_DRIVEN_THRESHOLD = 4096;
 
 		RubApp();
 		~RubApp();
@@ -30,6 +34,9 @@ namespace rub
 		Window window{ WIDTH, HEIGHT, "Rubidium Renderer" };
 		Device device{ window };
 		Renderer renderer{ window, device };
+		ThreadPool threadPool{};
+		GeometryArena geometryArena{ device, Model::VERTEX_STRIDE };
+		AssetManager assetManager{ device, geometryArena, threadPool };
 
 		std::vector<RenderObject> renderObjects;
 		std::unique_ptr<Scene> scene;
@@ -0,0 +1,68 @@
+#include "asset_manager.hpp"
+
+#include <chrono>
+
+namespace rub
+{
+	AssetManager::AssetManager(Device& device, GeometryArena& geometryArena, ThreadPool& threadPool) :
+		device{ device }, geometryArena{ geometryArena }, threadPool{ threadPool }
+	{
+
+	}
+
+	std::shared_ptr<Model> AssetManager::loadModel(const std::string& path, Model::Optimization optimization)
+	{
+		std::shared_ptr<Model> model = std::make_shared<Model>(device, geometryArena, optimization);
+
+		PendingAsset asset{};
+		asset.decoded = threadPool.enqueue([model, path]() { model->decode(path); });
+		asset.upload = [model]() { model->upload(); };
+		pending.push_back(std::move(asset));
+
+		return model;
+	}
+
+	std::shared_ptr<Texture> AssetManager::loadTexture(const std::string& path, Texture::Format format)
+	{
+		std::shared_ptr<Texture> texture = std::make_shared<Texture>(device, format);
+
+		PendingAsset asset{};
+		asset.decoded = threadPool.enqueue([texture, path]() { texture->decode(path); });
+		asset.upload = [texture]() { texture->upload(); };
+		pending.push_back(std::move(asset));
+
+		return texture;
+	}
+
+	void AssetManager::update()
+	{
+		for (size_t i = 0; i < pending.size();)
+		{
+			if (pending[i].decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				i++;
+				continue;
+			}
+
+			uploadAsset(pending[i]);
+			pending[i] = std::move(pending.back());
+			pending.pop_back();
+		}
+	}
+
+	void AssetManager::uploadAsset(PendingAsset& asset)
+	{
+		//Rethrows anything the decode threw on the worker
+		asset.decoded.get();
+		asset.upload();
+	}
+
+	AssetManager::~AssetManager()
+	{
+		//The workers still hold the assets, so they only have to finish before the thread pool and device go away
+		for (PendingAsset& asset : pending)
+		{
+			asset.decoded.wait();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "device.hpp"
+#include "model.hpp"
+#include "texture.hpp"
+#include "thread_pool.hpp"
+
+#include <future>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rub
+{
+	//Hands out models and textures straight away and decodes their files on the thread pool. Whatever has finished decoding is
+	//uploaded on the main thread in update(), after which the handle reports isReady() once its upload batch has completed.
+	//Until then a handle is safe to hold and pass around, it just must not be drawn
+	class AssetManager
+	{
+	public:
+		AssetManager(Device& device, GeometryArena& geometryArena, ThreadPool& threadPool);
+		~AssetManager();
+
+		AssetManager(const AssetManager&) = delete;
+		AssetManager& operator=(const AssetManager&) = delete;
+
+		std::shared_ptr<Model> loadModel(const std::string& path, Model::Optimization optimization = Model::Optimization::VertexCache);
+		std::shared_ptr<Texture> loadTexture(const std::string& path, Texture::Format format);
+
+		//Uploads every asset whose decode has finished, call once per frame before the upload batcher is flushed
+		void update();
+
+		size_t getPendingCount() const { return pending.size(); }
+
+	private:
+		struct PendingAsset
+		{
+			std::future<void> decoded;
+			//Keeps the asset alive while a worker writes to it and records its upload once the worker is done
+			std::function<void()> upload;
+		};
+
+		Device& device;
+		GeometryArena& geometryArena;
+		ThreadPool& threadPool;
+
+		std::vector<PendingAsset> pending;
+
+		void uploadAsset(PendingAsset& asset);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "benchmark.hpp"
+
+#include "frustum_cull.hpp"
+#include "transform_batch.hpp"
+#include "vertex_dedup.hpp"
+#include "model.hpp"
+
+#include <glm/gtx/hash.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <unordered_map>
+
+namespace rub
+{
+	//The OBJ loader's original vertex hash, kept so the dedup benchmark can compare against it
+	struct LegacyVertexHash
+	{
+		size_t operator()(const Model::Vertex& vertex) const
+		{
+			return ((std::hash<glm::vec3>()(vertex.position) ^ (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ (std::hash<glm::vec2>()(vertex.texCoord) << 1);
+		}
+	};
+
+	bool Benchmark::run(int argc, char* argv[])
+	{
+		bool ran = false;
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--benchmark-cull") == 0)
+			{
+				frustumCull();
+				ran = true;
+			}
+			else if (std::strcmp(argv[i], "--benchmark-mvp") == 0)
+			{
+				transformBatch();
+				ran = true;
+			}
+			else if (std::strcmp(argv[i], "--benchmark-dedup") == 0)
+			{
+				vertexDedup();
+				ran = true;
+			}
+		}
+
+		return ran;
+	}
+
+	void Benchmark::frustumCull()
+	{
+		using namespace std::chrono;
+
+		//Symmetric clip space box from -1 to 1 on x and y, 0 to 1 on z
+		glm::mat4 viewProjection{ 1.0f };
+		viewProjection[2][2] = 0.5f;
+		viewProjection[3][2] = 0.5f;
+		Frustum frustum = FrustumCull::extractFrustum(viewProjection);
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+		std::uniform_real_distribution<float> radius(0.01f, 0.25f);
+
+		std::cout << "Frustum culling (objects culled per microsecond)" << std::endl;
+		for (size_t count : { 10000, 100000, 1000000 })
+		{
+			BoundingSpheres spheres;
+			spheres.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				spheres.centerX[i] = position(random);
+				spheres.centerY[i] = position(random);
+				spheres.centerZ[i] = position(random);
+				spheres.radius[i] = radius(random);
+			}
+			std::vector<uint32_t> visible(count);
+
+			const int iterations = static_cast<int>(std::max<size_t>(10, 10000000 / count));
+			size_t visibleCount = 0;
+
+			auto scalarStart = high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				visibleCount = FrustumCull::cullSpheresScalar(frustum, spheres, visible.data());
+			}
+			duration<double, std::micro> scalarTime = high_resolution_clock::now() - scalarStart;
+
+			auto simdStart = high_resolution_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				visibleCount = FrustumCull::cullSpheres(frustum, spheres, visible.data());
+			}
+			duration<double, std::micro> simdTime = high_resolution_clock::now() - simdStart;
+
+			double scalarRate = count * iterations / scalarTime.count();
+			double simdRate = count * iterations / simdTime.count();
+			std::cout << std::fixed << std::setprecision(1) << "\t" << count << " objects (" << visibleCount << " visible): scalar " << scalarRate
+				<< ", simd " << simdRate << " (" << simdRate / scalarRate << "x)" << std::endl;
+		}
+	}
+	void Benchmark::transformBatch()
+	{
+		using namespace std::chrono;
+
+		glm::mat4 projection{ 1.0f };
+		projection[2][2] = 0.5f;
+		projection[3][2] = 0.5f;
+		glm::mat4 view{ 1.0f };
+		view[3] = glm::vec4(0.0f, -1.0f, -5.0f, 1.0f);
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+		ThreadPool threadPool;
+
+		std::cout << "MVP matrices (matrices per microsecond, " << threadPool.getThreadCount() << " threads)" << std::endl;
+		for (size_t count : { 10000, 100000, 1000000 })
+		{
+			std::vector<glm::mat4> models(count);
+			for (glm::mat4& model : models)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					model[column] = glm::vec4(value(random), value(random), value(random), column == 3 ? 1.0f : 0.0f);
+				}
+			}
+			std::vector<glm::mat4> results(count);
+
+			const int iterations = static_cast<int>(std::max<size_t>(10, 10000000 / count));
+			auto measure = [&](auto&& function)
+			{
+				auto start = high_resolution_clock::now();
+				for (int i = 0; i < iterations; i++)
+				{
+					function();
+				}
+				duration<double, std::micro> time = high_resolution_clock::now() - start;
+				return count * iterations / time.count();
+			};
+
+			//What the object loop used to do, two multiplies per object
+			double perObjectRate = measure([&]()
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						results[i] = projection * view * models[i];
+					}
+				});
+			glm::mat4 viewProjection = projection * view;
+			double hoistedRate = measure([&]() { TransformBatch::multiplyScalar(viewProjection, models.data(), results.data(), count); });
+			double simdRate = measure([&]() { TransformBatch::multiply(viewProjection, models.data(), results.data(), count); });
+			double parallelRate = measure([&]() { TransformBatch::multiplyParallel(threadPool, viewProjection, models.data(), results.data(), count); });
+
+			std::cout << std::fixed << std::setprecision(1) << "\t" << count << " objects: per object " << perObjectRate << ", hoisted " << hoistedRate
+				<< ", simd " << simdRate << " (" << simdRate / perObjectRate << "x), parallel " << parallelRate << " (" << parallelRate / perObjectRate << "x)" << std::endl;
+		}
+	}
+	void Benchmark::vertexDedup()
+	{
+		using namespace std::chrono;
+
+		std::cout << "Vertex dedup (milliseconds, best of 3)" << std::endl;
+		//Smooth grids, where every interior vertex is shared by six triangles like a typical closed mesh
+		for (int side : { 708, 1415 })
+		{
+			int cells = side - 1;
+			std::vector<float> positions(side * side * 3);
+			std::vector<float> normals(side * side * 3);
+			std::vector<float> texCoords(side * side * 2);
+			for (int y = 0; y < side; y++)
+			{
+				for (int x = 0; x < side; x++)
+				{
+					int vertex = y * side + x;
+					positions[vertex * 3 + 0] = static_cast<float>(x);
+					positions[vertex * 3 + 1] = 0.0f;
+					positions[vertex * 3 + 2] = static_cast<float>(y);
+					normals[vertex * 3 + 1] = 1.0f;
+					texCoords[vertex * 2 + 0] = static_cast<float>(x) / cells;
+					texCoords[vertex * 2 + 1] = static_cast<float>(y) / cells;
+				}
+			}
+
+			std::vector<VertexDedup::Key> keys;
+			keys.reserve(static_cast<size_t>(cells) * cells * 6);
+			for (int y = 0; y < cells; y++)
+			{
+				for (int x = 0; x < cells; x++)
+				{
+					int corners[6] = { y * side + x, (y + 1) * side + x, y * side + x + 1, y * side + x + 1, (y + 1) * side + x, (y + 1) * side + x + 1 };
+					for (int corner : corners)
+					{
+						keys.push_back({ corner, corner, corner });
+					}
+				}
+			}
+
+			auto buildVertex = [&](const VertexDedup::Key& key)
+			{
+				Model::Vertex vertex{};
+				vertex.position = { positions[3 * key.position + 0], positions[3 * key.position + 1], positions[3 * key.position + 2] };
+				vertex.normal = { normals[3 * key.normal + 0], normals[3 * key.normal + 1], normals[3 * key.normal + 2] };
+				vertex.texCoord = { texCoords[2 * key.texCoord + 0], texCoords[2 * key.texCoord + 1] };
+				vertex.color = { 1, 1, 1 };
+				return vertex;
+			};
+
+			auto measure = [&](auto&& function)
+			{
+				double best = std::numeric_limits<double>::max();
+				for (int i = 0; i < 3; i++)
+				{
+					auto start = high_resolution_clock::now();
+					function();
+					duration<double, std::milli> time = high_resolution_clock::now() - start;
+					best = std::min(best, time.count());
+				}
+				return best;
+			};
+
+			size_t legacyCount = 0;
+			double legacyTime = measure([&]()
+				{
+					std::vector<Model::Vertex> vertices;
+					std::vector<uint32_t> indices;
+					std::unordered_map<Model::Vertex, uint32_t, LegacyVertexHash> uniqueVertices{};
+					for (const VertexDedup::Key& key : keys)
+					{
+						Model::Vertex vertex = buildVertex(key);
+						if (uniqueVertices.count(vertex) == 0)
+						{
+							uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+							vertices.push_back(vertex);
+						}
+						indices.push_back(uniqueVertices[vertex]);
+					}
+					legacyCount = vertices.size();
+				});
+
+			size_t dedupCount = 0;
+			double dedupTime = measure([&]()
+				{
+					std::vector<Model::Vertex> vertices;
+					std::vector<uint32_t> indices;
+					indices.reserve(keys.size());
+					VertexDedup uniqueVertices{ keys.size() };
+					for (const VertexDedup::Key& key : keys)
+					{
+						bool isNew;
+						indices.push_back(uniqueVertices.insert(key, isNew));
+						if (isNew)
+						{
+							vertices.push_back(buildVertex(key));
+						}
+					}
+					dedupCount = vertices.size();
+				});
+
+			std::cout << std::fixed << std::setprecision(1) << "\t" << keys.size() / 3 << " triangles: unordered_map " << legacyTime << " (" << legacyCount
+				<< " vertices), open addressing " << dedupTime << " (" << dedupCount << " vertices, " << legacyTime / dedupTime << "x)" << std::endl;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace rub
+{
+	//Standalone CPU micro-benchmarks, run from the command line instead of the renderer
+	class Benchmark
+	{
+	public:
+		//Returns true if a benchmark was requested and run
+		static bool run(int argc, char* argv[]);
+
+		static void frustumCull();
+		static void transformBatch();
+		static void vertexDedup();
+	};
+}
\ No newline at end of file
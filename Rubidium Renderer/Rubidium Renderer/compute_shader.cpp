@@ -13,6 +13,13 @@ namespace rub
 		createPipeline();
 	}
 
+	ComputeShader::ComputeShader(Device& device, const std::string& compPath, std::vector<VkDescriptorSetLayout>& setLayouts, uint32_t pushConstantSize)
+		: device{ device }, compPath{ compPath }, pushConstantSize{ pushConstantSize }
+	{
+		createPipelineLayout(setLayouts);
+		createPipeline();
+	}
+
 	void ComputeShader::createDescriptorSetLayout()
 	{
 		VkDescriptorSetLayoutBinding targetBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
@@ -48,13 +55,23 @@ namespace rub
 	void ComputeShader::createPipelineLayout(std::vector<VkDescriptorSetLayout>& setLayouts)
 	{
 		std::vector<VkDescriptorSetLayout> finalSet;
-		finalSet.push_back(setLayout);
+		if (setLayout != VK_NULL_HANDLE)
+		{
+			finalSet.push_back(setLayout);
+		}
 		finalSet.insert(finalSet.end(), setLayouts.begin(), setLayouts.end());
 
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = finalSet.size();
 		pipelineLayoutInfo.pSetLayouts = finalSet.data();
+		pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		vkCreatePipelineLayout(device.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout);
 	}
 
@@ -66,7 +83,15 @@ namespace rub
 	void ComputeShader::bind(VkCommandBuffer commandBuffer)
 	{
 		pipeline->bind(commandBuffer);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		if (descriptorSet != VK_NULL_HANDLE)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		}
+	}
+
+	void ComputeShader::pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size)
+	{
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
 	}
 
 	ComputeShader::~ComputeShader()
@@ -10,19 +10,24 @@ namespace rub
 	{
 	public:
 		ComputeShader(Device& device, const std::string& compPath, VkImageView targetImage, std::vector<VkDescriptorSetLayout>& setLayouts);
+		//Buffer-only shader: every set is supplied by the caller, plus an optional push constant block
+		ComputeShader(Device& device, const std::string& compPath, std::vector<VkDescriptorSetLayout>& setLayouts, uint32_t pushConstantSize = 0);
 		~ComputeShader();
 
 		void bind(VkCommandBuffer commandBuffer);
+		void pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size);
+		VkPipelineLayout getLayout() { return pipelineLayout; }
 
 	private:
 		Device& device;
 		std::string compPath;
-		VkImageView targetImage;
+		VkImageView targetImage = VK_NULL_HANDLE;
+		uint32_t pushConstantSize = 0;
 
-		VkDescriptorSetLayout setLayout;
-		VkDescriptorSet descriptorSet;
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
-		VkSampler targetSampler;
+		VkSampler targetSampler = VK_NULL_HANDLE;
 
 		VkPipelineLayout pipelineLayout;
 		std::unique_ptr<Pipeline> pipeline;
@@ -1,12 +1,13 @@
 #include "cubemap.hpp"
+#include "upload_batcher.hpp"
 
 #include <stdexcept>
 
 namespace rub
 {
-	Cubemap::Cubemap(Device& device) : device{ device }
+	Cubemap::Cubemap(Device& device, GeometryArena& geometryArena) : device{ device }
 	{
-		cubeModel = std::make_shared<Model>(device, "models/cube.obj");
+		cubeModel = std::make_shared<Model>(device, geometryArena, "models/cube.obj");
 
 		createImages();
 		createRenderPass();
@@ -20,9 +21,22 @@ namespace rub
 		VmaAllocationCreateInfo imageAllocation{};
 		imageAllocation.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-		//Create capture image
-		VkImageCreateInfo captureImageInfo = VkUtil::imageCreateInfo(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 
-			captureExtent, 1);
+		//Create capture image, only the first level is rendered to and the downsampler fills the rest in place.
+		//Without the downsampler the chain is blitted, and without linear blits either the filters sample the first level alone
+		VkImageUsageFlags captureUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		captureSourceLevels = 1;
+		captureDownsampled = MipDownsampler::isSupported(device, VK_FORMAT_R16G16B16A16_SFLOAT, captureExtent);
+		if (captureDownsampled)
+		{
+			captureUsage |= MipDownsampler::IMAGE_USAGE;
+			captureSourceLevels = captureMipLevels;
+		}
+		else if (device.isFormatSupported(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL, UploadBatcher::BLIT_MIP_FEATURES))
+		{
+			captureUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			captureSourceLevels = captureMipLevels;
+		}
+		VkImageCreateInfo captureImageInfo = VkUtil::imageCreateInfo(VK_FORMAT_R16G16B16A16_SFLOAT, captureUsage, captureExtent, captureSourceLevels);
 		captureImageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		captureImageInfo.arrayLayers = 6;
 		vmaCreateImage(device.getAllocator(), &captureImageInfo, &imageAllocation, &captureImage.image, &captureImage.allocation, nullptr);
@@ -37,7 +51,7 @@ namespace rub
 			irradianceExtent, 1);
 		irradianceImageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		irradianceImageInfo.arrayLayers = 6;
-		vmaCreateImage(device.getAllocator(), &captureImageInfo, &imageAllocation, &irradianceImage.image, &irradianceImage.allocation, nullptr);
+		vmaCreateImage(device.getAllocator(), &irradianceImageInfo, &imageAllocation, &irradianceImage.image, &irradianceImage.allocation, nullptr);
 
 		VkImageViewCreateInfo irradianceViewInfo = VkUtil::imageViewCreateInfo(VK_FORMAT_R16G16B16A16_SFLOAT, irradianceImage.image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 		irradianceViewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
@@ -232,37 +246,44 @@ namespace rub
 		//Capture environment
 		capture(commandBuffer, renderObjects, captureFramebuffer, captureExtent, captureImage, captureImageView);
 
-		//Create new image with mips
-		AllocatedImage newImage;
-		VkImageCreateInfo captureImageInfo = VkUtil::imageCreateInfo(VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			captureExtent, captureMipLevels);
-		captureImageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-		captureImageInfo.arrayLayers = 6;
-		VmaAllocationCreateInfo allocationInfo{};
-		allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-		vmaCreateImage(device.getAllocator(), &captureImageInfo, &allocationInfo, &newImage.image, &newImage.allocation, nullptr);
-
-		//Generate mip maps
-		VkUtil::generateMipMaps(commandBuffer, captureImage.image, newImage.image, captureExtent.width, captureExtent.height, 6);
+		//Generate mip maps for all six faces in one dispatch
+		if (captureDownsampled)
+		{
+			device.getMipDownsampler().record(commandBuffer, captureImage.image, VK_FORMAT_R16G16B16A16_SFLOAT, captureExtent, captureSourceLevels, 6,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, captureDownsample);
+		}
+		else if (captureSourceLevels > 1)
+		{
+			VkUtil::generateMipMaps(commandBuffer, captureImage.image, captureExtent, captureSourceLevels, 6, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+		}
+		else
+		{
+			VkImageMemoryBarrier toShaderRead = VkUtil::imageMemoryBarrier(captureImage.image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 6);
+			toShaderRead.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			toShaderRead.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			toShaderRead.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			toShaderRead.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 
+				1, &toShaderRead);
+		}
 
 		//Create new image view with mips
 		VkImageView newImageView;
-		VkImageViewCreateInfo captureViewInfo = VkUtil::imageViewCreateInfo(VK_FORMAT_R16G16B16A16_SFLOAT, newImage.image, VK_IMAGE_ASPECT_COLOR_BIT, captureMipLevels);
+		VkImageViewCreateInfo captureViewInfo = VkUtil::imageViewCreateInfo(VK_FORMAT_R16G16B16A16_SFLOAT, captureImage.image, VK_IMAGE_ASPECT_COLOR_BIT, captureSourceLevels);
 		captureViewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
 		captureViewInfo.subresourceRange.layerCount = 6;
 		vkCreateImageView(device.getDevice(), &captureViewInfo, nullptr, &newImageView);
 
-		destroyImages.push_back(captureImage);
 		destroyImageViews.push_back(captureImageView);
 
-		captureImage = newImage;
 		captureImageView = newImageView;
 	}
 
 	void Cubemap::captureIrradiance(VkCommandBuffer commandBuffer)
 	{
 		//Create render object
-		std::shared_ptr<Texture> irradianceTexture = std::make_shared<Texture>(device, captureImageView, captureMipLevels);
+		std::shared_ptr<Texture> irradianceTexture = std::make_shared<Texture>(device, captureImageView, captureSourceLevels);
 		irradianceMaterial = std::make_shared<Material>(device, "shaders/cubemap.vert.spv", "shaders/irradiance_convolution.frag.spv");
 		irradianceMaterial->addTexture(irradianceTexture);
 
@@ -296,7 +317,7 @@ namespace rub
 	void Cubemap::capturePrefilter(VkCommandBuffer commandBuffer)
 	{
 		//Create render object
-		std::shared_ptr<Texture> prefilterTexture = std::make_shared<Texture>(device, captureImageView, captureMipLevels);
+		std::shared_ptr<Texture> prefilterTexture = std::make_shared<Texture>(device, captureImageView, captureSourceLevels);
 		prefilterMaterial = std::make_shared<Material>(device, "shaders/cubemap.vert.spv", "shaders/prefilter.frag.spv");
 		prefilterMaterial->addTexture(prefilterTexture);
 
@@ -408,6 +429,8 @@ namespace rub
 		}
 		destroyImages.clear();
 		destroyImageViews.clear();
+
+		device.getMipDownsampler().release(captureDownsample);
 	}
 
 	Cubemap::~Cubemap()
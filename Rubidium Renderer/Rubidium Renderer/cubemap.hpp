@@ -1,6 +1,7 @@
 #pragma once
 
 #include "render_object.hpp"
+#include "mip_downsampler.hpp"
 #include "vk_util.hpp"
 
 namespace rub
@@ -18,7 +19,7 @@ namespace rub
 			float roughness;
 		};
 
-		Cubemap(Device& device);
+		Cubemap(Device& device, GeometryArena& geometryArena);
 		~Cubemap();
 
 		void capture(std::vector<RenderObject>& renderObjects);
@@ -35,6 +36,10 @@ namespace rub
 		const VkExtent2D captureExtent = { 512, 512 };
 		const VkExtent2D irradianceExtent = { 32, 32 };
 		const int captureMipLevels = VkUtil::calculateMipLevels(captureExtent.width, captureExtent.height);;
+		//Levels of the capture image the environment is filtered from, only the first when its chain can't be generated
+		int captureSourceLevels = 1;
+		//Whether the mip downsampler fills the capture chain, blits do otherwise
+		bool captureDownsampled = false;
 
 		VkRenderPass renderPass;
 
@@ -56,6 +61,7 @@ namespace rub
 
 		std::vector<AllocatedImage> destroyImages;
 		std::vector<VkImageView> destroyImageViews;
+		MipDownsampler::Resources captureDownsample;
 
 		std::shared_ptr<Model> cubeModel;
 		std::shared_ptr<Material> irradianceMaterial;
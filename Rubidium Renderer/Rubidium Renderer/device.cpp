@@ -1,5 +1,7 @@
 #define VMA_IMPLEMENTATION
 #include "device.hpp"
+#include "upload_batcher.hpp"
+#include "mip_downsampler.hpp"
 
 #include <stdexcept>
 #include <iostream>
@@ -60,6 +62,7 @@ namespace rub
 		createAllocator();
 		createCommandPool();
 		createDescriptorPool();
+		uploadBatcher = std::make_unique<UploadBatcher>(*this);
 	}
 
 	void Device::createInstance()
@@ -159,6 +162,10 @@ namespace rub
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		if (indices.transferFamily.has_value())
+		{
+			uniqueQueueFamilies.insert(indices.transferFamily.value());
+		}
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -172,12 +179,35 @@ namespace rub
 		}
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+		//The mip downsampler writes every format through one shader, indexing an array of storage images. Without both features
+		//textures and the environment capture blit their chains instead
+		storageImageDownsampling = supportedFeatures.shaderStorageImageWriteWithoutFormat == VK_TRUE && 
+			supportedFeatures.shaderStorageImageArrayDynamicIndexing == VK_TRUE;
+		deviceFeatures.shaderStorageImageWriteWithoutFormat = storageImageDownsampling;
+		deviceFeatures.shaderStorageImageArrayDynamicIndexing = storageImageDownsampling;
+
+		//Cooked textures are block compressed, without the feature they fall back to their sources
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		blockCompression = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+		//GPU driven batches draw all their ranges in one call when multi draw indirect is there, and one call per range otherwise
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
 
 		VkPhysicalDeviceVulkan11Features vulkan11Features{};
 		vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
 		vulkan11Features.shaderDrawParameters = true;
 		vulkan11Features.multiview = true;
 
+		//Uploads signal a timeline semaphore so residency can be polled without a fence per batch
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.timelineSemaphore = true;
+		vulkan11Features.pNext = &vulkan12Features;
+
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.pNext = &vulkan11Features;
@@ -207,6 +237,7 @@ namespace rub
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+		vkGetDeviceQueue(device, indices.transferFamily.value_or(indices.graphicsFamily.value()), 0, &transferQueue);
 	}
 
 	void Device::createCommandPool()
@@ -333,6 +364,30 @@ namespace rub
 			i++;
 		}
 
+		if (indices.graphicsFamily.has_value())
+		{
+			indices.graphicsTimestampValidBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+		}
+
+		//A family that can transfer but not draw is usually backed by the copy engines, so uploads there overlap with rendering.
+		//One without compute either is the closest thing to a pure copy engine
+		for (uint32_t family = 0; family < queueFamilyCount; family++)
+		{
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				bool copyOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+				if (copyOnly || !indices.transferFamily.has_value())
+				{
+					indices.transferFamily = family;
+				}
+				if (copyOnly)
+				{
+					break;
+				}
+			}
+		}
+
 		return indices;
 	}
 
@@ -448,14 +503,7 @@ namespace rub
 	{
 		for (VkFormat format : candidates)
 		{
-			VkFormatProperties props;
-			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
-			{
-				return format;
-			}
-			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
+			if (isFormatSupported(format, tiling, features))
 			{
 				return format;
 			}
@@ -463,6 +511,18 @@ namespace rub
 		throw std::runtime_error("failed to find supported format!");
 	}
 
+	bool Device::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR)
+		{
+			return (props.linearTilingFeatures & features) == features;
+		}
+		return (props.optimalTilingFeatures & features) == features;
+	}
+
 	//void Device::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
 	//{
 	//	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
@@ -506,6 +566,28 @@ namespace rub
 		}
 	}
 
+	void Device::createMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocatedBuffer& allocatedBuffer, void** mappedData)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		//Keep the allocation mapped for its whole lifetime instead of mapping every update
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = memoryUsage;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo allocationInfo{};
+		if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &allocatedBuffer.buffer, &allocatedBuffer.allocation, &allocationInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate buffer memory!");
+		}
+
+		*mappedData = allocationInfo.pMappedData;
+	}
+
 	VkCommandBuffer Device::beginSingleTimeCommands()
 	{
 		VkCommandBufferAllocateInfo allocInfo{};
@@ -530,6 +612,9 @@ namespace rub
 	{
 		vkEndCommandBuffer(commandBuffer);
 
+		//Submit pending uploads first so the one-off work can read what they write
+		uploadBatcher->flush();
+
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		submitInfo.commandBufferCount = 1;
@@ -548,7 +633,7 @@ namespace rub
 		{
 			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
 			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 32 },
 			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 },
 			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 10 }
 		};
@@ -563,6 +648,15 @@ namespace rub
 		vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
 	}
 
+	MipDownsampler& Device::getMipDownsampler()
+	{
+		if (mipDownsampler == nullptr)
+		{
+			mipDownsampler = std::make_unique<MipDownsampler>(*this);
+		}
+		return *mipDownsampler;
+	}
+
 	void Device::getDescriptor(VkDescriptorSetLayout& setLayout, VkDescriptorSet& descriptorSet)
 	{
 		VkDescriptorSetAllocateInfo allocInfo = {};
@@ -605,6 +699,8 @@ namespace rub
 
 	Device::~Device()
 	{
+		uploadBatcher.reset();
+		mipDownsampler.reset();
 		vmaDestroyAllocator(allocator);
 		vkDestroyCommandPool(device, commandPool, nullptr);
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -4,11 +4,15 @@
 
 #include <vma/vk_mem_alloc.h>
 
+#include <memory>
 #include <optional>
 #include <vector>
 
 namespace rub
 {
+	class UploadBatcher;
+	class MipDownsampler;
+
 	struct AllocatedBuffer
 	{
 		VkBuffer buffer;
@@ -32,6 +36,10 @@ namespace rub
 	{
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		//Only set when the GPU has a family that can transfer but not draw
+		std::optional<uint32_t> transferFamily;
+		//Meaningful bits in timestamps written on the graphics family, 0 when it can't write them
+		uint32_t graphicsTimestampValidBits = 0;
 
 		bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
 	};
@@ -53,13 +61,25 @@ namespace rub
 		VkSurfaceKHR getSurface() { return surface; }
 		VkQueue getGraphicsQueue() { return graphicsQueue; }
 		VkQueue getPresentQueue() { return presentQueue; }
+		//Falls back to the graphics queue when there's no dedicated transfer family
+		VkQueue getTransferQueue() { return transferQueue; }
 		VmaAllocator getAllocator() { return allocator; }
+		UploadBatcher& getUploadBatcher() { return *uploadBatcher; }
+		//Created on first use, it loads a shader
+		MipDownsampler& getMipDownsampler();
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 		QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
 		VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+		bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
+		//Whether BC1-BC7 images can be sampled, which decides if textures load their cooked files
+		bool supportsBlockCompression() { return blockCompression; }
+		//Whether the storage image features the mip downsampler's shader relies on were enabled
+		bool supportsStorageImageDownsampling() { return storageImageDownsampling; }
+		bool supportsMultiDrawIndirect() { return multiDrawIndirect; }
 		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocatedBuffer& allocatedBuffer);
+		void createMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocatedBuffer& allocatedBuffer, void** mappedData);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void getDescriptor(VkDescriptorSetLayout& setLayout, VkDescriptorSet& descriptorSet);
@@ -76,6 +96,7 @@ namespace rub
 		VkSurfaceKHR surface;
 		VkQueue graphicsQueue;
 		VkQueue presentQueue;
+		VkQueue transferQueue;
 		VmaAllocator allocator;
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
@@ -84,8 +105,13 @@ namespace rub
 
 		VkCommandPool commandPool;
 		VkDescriptorPool descriptorPool;
+		std::unique_ptr<UploadBatcher> uploadBatcher;
+		std::unique_ptr<MipDownsampler> mipDownsampler;
 
 		VkPhysicalDeviceProperties deviceProperties;
+		bool blockCompression = false;
+		bool storageImageDownsampling = false;
+		bool multiDrawIndirect = false;
 
 		void createInstance();
 		void setupDebugMessenger();
@@ -0,0 +1,80 @@
+#include "draw_sort.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace rub
+{
+	uint64_t DrawSort::makeKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float depth)
+	{
+		//The bit pattern of a non-negative float sorts the same way as its value, so its top bits make a cheap quantized depth
+		uint32_t depthBits = 0;
+		if (depth > 0.0f)
+		{
+			std::memcpy(&depthBits, &depth, sizeof(depthBits));
+		}
+		depthBits >>= 32 - DEPTH_BITS;
+
+		uint64_t key = pipelineId & ((1u << PIPELINE_BITS) - 1);
+		key = (key << MATERIAL_BITS) | (materialId & ((1u << MATERIAL_BITS) - 1));
+		key = (key << MESH_BITS) | (meshId & ((1u << MESH_BITS) - 1));
+		key = (key << DEPTH_BITS) | depthBits;
+
+		return key;
+	}
+
+	void DrawSort::radixSort(std::vector<DrawCommand>& commands, std::vector<DrawCommand>& scratch)
+	{
+		constexpr int PASS_COUNT = sizeof(uint64_t);
+		constexpr int BUCKET_COUNT = 256;
+
+		scratch.resize(commands.size());
+		if (commands.size() < 2)
+		{
+			return;
+		}
+
+		//Build every histogram in a single read of the keys
+		std::array<std::array<uint32_t, BUCKET_COUNT>, PASS_COUNT> histograms{};
+		for (const DrawCommand& command : commands)
+		{
+			for (int pass = 0; pass < PASS_COUNT; pass++)
+			{
+				histograms[pass][(command.sortKey >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		DrawCommand* source = commands.data();
+		DrawCommand* destination = scratch.data();
+		for (int pass = 0; pass < PASS_COUNT; pass++)
+		{
+			std::array<uint32_t, BUCKET_COUNT>& histogram = histograms[pass];
+
+			uint32_t firstByte = (source[0].sortKey >> (pass * 8)) & 0xFF;
+			if (histogram[firstByte] == commands.size())
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t& count : histogram)
+			{
+				uint32_t bucketSize = count;
+				count = offset;
+				offset += bucketSize;
+			}
+
+			for (size_t i = 0; i < commands.size(); i++)
+			{
+				destination[histogram[(source[i].sortKey >> (pass * 8)) & 0xFF]++] = source[i];
+			}
+
+			std::swap(source, destination);
+		}
+
+		if (source != commands.data())
+		{
+			commands.swap(scratch);
+		}
+	}
+}
\ No newline at end of file
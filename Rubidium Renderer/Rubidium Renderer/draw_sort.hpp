@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace rub
+{
+	struct DrawCommand
+	{
+		uint64_t sortKey;
+		uint32_t objectIndex;
+	};
+
+	struct DrawStats
+	{
+		uint32_t drawCount = 0;
+		uint32_t instanceCount = 0;
+		uint32_t culledCount = 0;
+		uint32_t bindsIssued = 0;
+		uint32_t bindsSkipped = 0;
+
+		DrawStats& operator+=(const DrawStats& other)
+		{
+			drawCount += other.drawCount;
+			instanceCount += other.instanceCount;
+			culledCount += other.culledCount;
+			bindsIssued += other.bindsIssued;
+			bindsSkipped += other.bindsSkipped;
+			return *this;
+		}
+	};
+
+	class DrawSort
+	{
+	public:
+		//Key layout from most to least significant: pipeline (12 bits), material (12 bits), mesh (16 bits), depth (24 bits)
+		static constexpr uint32_t PIPELINE_BITS = 12;
+		static constexpr uint32_t MATERIAL_BITS = 12;
+		static constexpr uint32_t MESH_BITS = 16;
+		static constexpr uint32_t DEPTH_BITS = 24;
+
+		static uint64_t makeKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float depth);
+		//LSD radix sort on sortKey, 8 bits per pass. Passes where every key shares the same byte are skipped
+		static void radixSort(std::vector<DrawCommand>& commands, std::vector<DrawCommand>& scratch);
+	};
+}
\ No newline at end of file
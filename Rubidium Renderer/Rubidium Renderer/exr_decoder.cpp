@@ -0,0 +1,394 @@
+#include "exr_decoder.hpp"
+
+#include "hdr_packer.hpp"
+
+#define TINYEXR_IMPLEMENTATION
+#include "tinyexr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+namespace rub
+{
+	static constexpr uint16_t HALF_ONE = 0x3C00;
+
+	static size_t getTexelSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return sizeof(uint16_t) * 4;
+		case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+			return sizeof(uint32_t);
+		default:
+			return sizeof(float) * 4;
+		}
+	}
+
+	//LoadEXR's mapping, R G B and A by name
+	static int getChannelIndex(const char* name)
+	{
+		static const char* CHANNEL_NAMES[] = { "R", "G", "B", "A" };
+		for (int i = 0; i < 4; i++)
+		{
+			if (strcmp(name, CHANNEL_NAMES[i]) == 0)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	ExrDecoder::ExrDecoder(ThreadPool* threadPool) : threadPool{ threadPool }
+	{
+
+	}
+
+	bool ExrDecoder::open(const std::string& path)
+	{
+		if (!file.open(path))
+		{
+			std::cout << "Failed to load texture file " << path << std::endl;
+			return false;
+		}
+		const uint8_t* data = file.getData();
+		size_t size = file.getSize();
+
+		EXRVersion version;
+		if (ParseEXRVersionFromMemory(&version, data, size) != TINYEXR_SUCCESS)
+		{
+			std::cout << "Failed to read EXR version of " << path << std::endl;
+			return false;
+		}
+
+		if (!version.multipart && !version.non_image)
+		{
+			header = std::make_unique<EXRHeader>();
+			InitEXRHeader(header.get());
+			const char* err = nullptr;
+			if (ParseEXRHeaderFromMemory(header.get(), &version, data, size, &err) != TINYEXR_SUCCESS)
+			{
+				if (err)
+				{
+					std::cout << err << std::endl;
+					FreeEXRErrorMessage(err);
+				}
+				//A failed parse leaves nothing to free
+				header.reset();
+				return false;
+			}
+
+			if (openBlocks(data, size))
+			{
+				return true;
+			}
+		}
+
+		int loadedWidth;
+		int loadedHeight;
+		const char* err = nullptr;
+		if (LoadEXRFromMemory(&fallbackPixels, &loadedWidth, &loadedHeight, data, size, &err) != TINYEXR_SUCCESS)
+		{
+			if (err)
+			{
+				std::cout << err << std::endl;
+				FreeEXRErrorMessage(err);
+			}
+			fallbackPixels = nullptr;
+			return false;
+		}
+		width = static_cast<uint32_t>(loadedWidth);
+		height = static_cast<uint32_t>(loadedHeight);
+		file.close();
+		return true;
+	}
+
+	//Offsets and block headers are read as they're stored, little endian like every platform the renderer runs on
+	bool ExrDecoder::openBlocks(const uint8_t* data, size_t size)
+	{
+		const EXRHeader& exrHeader = *header;
+		if (exrHeader.tiled)
+		{
+			return false;
+		}
+
+		switch (exrHeader.compression_type)
+		{
+		case TINYEXR_COMPRESSIONTYPE_NONE:
+		case TINYEXR_COMPRESSIONTYPE_RLE:
+		case TINYEXR_COMPRESSIONTYPE_ZIPS:
+			linesPerBlock = 1;
+			break;
+		case TINYEXR_COMPRESSIONTYPE_ZIP:
+			linesPerBlock = 16;
+			break;
+		case TINYEXR_COMPRESSIONTYPE_PIZ:
+			linesPerBlock = 32;
+			break;
+		default:
+			return false;
+		}
+
+		int64_t dataWidth = static_cast<int64_t>(exrHeader.data_window.max_x) - exrHeader.data_window.min_x + 1;
+		int64_t dataHeight = static_cast<int64_t>(exrHeader.data_window.max_y) - exrHeader.data_window.min_y + 1;
+		if (dataWidth <= 0 || dataHeight <= 0 || dataWidth > INT32_MAX || dataHeight > INT32_MAX)
+		{
+			return false;
+		}
+
+		texelSize = 0;
+		for (int c = 0; c < exrHeader.num_channels; c++)
+		{
+			int pixelType = exrHeader.pixel_types[c];
+			int index = exrHeader.num_channels == 1 ? 0 : getChannelIndex(exrHeader.channels[c].name);
+			if (index >= 0)
+			{
+				//Integer channels hold IDs rather than colour, LoadEXR can have those
+				if (pixelType == TINYEXR_PIXELTYPE_UINT)
+				{
+					return false;
+				}
+				channels[index].offset = texelSize;
+				channels[index].isHalf = pixelType == TINYEXR_PIXELTYPE_HALF;
+				channels[index].exists = true;
+			}
+			texelSize += pixelType == TINYEXR_PIXELTYPE_HALF ? sizeof(uint16_t) : sizeof(float);
+		}
+
+		if (exrHeader.num_channels == 1)
+		{
+			channels[1] = channels[0];
+			channels[2] = channels[0];
+			channels[3] = channels[0];
+		}
+		else if (!channels[0].exists || !channels[1].exists || !channels[2].exists)
+		{
+			return false;
+		}
+
+		uint64_t blockCount = exrHeader.chunk_count > 0 ? static_cast<uint64_t>(exrHeader.chunk_count) : (dataHeight + linesPerBlock - 1) / linesPerBlock;
+		size_t tableOffset = static_cast<size_t>(exrHeader.header_len) + tinyexr::kEXRVersionSize;
+		if (tableOffset + blockCount * sizeof(uint64_t) > size)
+		{
+			return false;
+		}
+		blockOffsets.resize(blockCount);
+		memcpy(blockOffsets.data(), data + tableOffset, blockCount * sizeof(uint64_t));
+
+		//Incomplete files have holes in the table that LoadEXR rebuilds by walking the blocks
+		for (uint64_t offset : blockOffsets)
+		{
+			if (offset < tableOffset || offset + sizeof(int32_t) * 2 > size)
+			{
+				return false;
+			}
+		}
+
+		width = static_cast<uint32_t>(dataWidth);
+		height = static_cast<uint32_t>(dataHeight);
+		return true;
+	}
+
+	bool ExrDecoder::decode(VkFormat format, void* pixels)
+	{
+		uint8_t* destination = static_cast<uint8_t*>(pixels);
+		if (fallbackPixels != nullptr)
+		{
+			size_t texelCount = static_cast<size_t>(width) * height;
+			if (format == VK_FORMAT_R16G16B16A16_SFLOAT)
+			{
+				HdrPacker::packHalf(fallbackPixels, reinterpret_cast<uint16_t*>(destination), texelCount * 4);
+			}
+			else if (format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+			{
+				HdrPacker::packSharedExponent(fallbackPixels, reinterpret_cast<uint32_t*>(destination), texelCount);
+			}
+			else
+			{
+				memcpy(destination, fallbackPixels, texelCount * sizeof(float) * 4);
+			}
+			return true;
+		}
+
+		std::atomic<bool> failed = false;
+		auto task = [&](uint32_t block)
+		{
+			if (!decodeBlock(block, format, destination))
+			{
+				failed = true;
+			}
+		};
+
+		uint32_t blockCount = static_cast<uint32_t>(blockOffsets.size());
+		if (threadPool != nullptr && blockCount > 1)
+		{
+			threadPool->parallelFor(blockCount, task);
+		}
+		else
+		{
+			for (uint32_t block = 0; block < blockCount; block++)
+			{
+				task(block);
+			}
+		}
+		return !failed;
+	}
+
+	bool ExrDecoder::decodeBlock(uint32_t block, VkFormat format, uint8_t* pixels)
+	{
+		const uint8_t* data = file.getData();
+		size_t size = file.getSize();
+		uint64_t offset = blockOffsets[block];
+
+		int32_t lineNumber;
+		int32_t dataSize;
+		memcpy(&lineNumber, data + offset, sizeof(lineNumber));
+		memcpy(&dataSize, data + offset + sizeof(lineNumber), sizeof(dataSize));
+		int64_t firstLine = static_cast<int64_t>(lineNumber) - header->data_window.min_y;
+		if (dataSize <= 0 || offset + sizeof(int32_t) * 2 + dataSize > size || firstLine < 0 || firstLine >= height)
+		{
+			return false;
+		}
+
+		uint32_t lineCount = std::min(linesPerBlock, height - static_cast<uint32_t>(firstLine));
+		size_t lineSize = texelSize * width;
+		size_t blockSize = lineSize * lineCount;
+		const uint8_t* source = data + offset + sizeof(int32_t) * 2;
+
+		//Every compression stores a block as is when that's no larger, which is read straight from the mapping
+		std::vector<uint8_t> decompressed;
+		if (static_cast<size_t>(dataSize) != blockSize)
+		{
+			decompressed.resize(blockSize);
+			bool decompressedBlock = false;
+			switch (header->compression_type)
+			{
+			case TINYEXR_COMPRESSIONTYPE_RLE:
+				decompressedBlock = tinyexr::DecompressRle(decompressed.data(), static_cast<unsigned long>(blockSize), source, static_cast<unsigned long>(dataSize));
+				break;
+			case TINYEXR_COMPRESSIONTYPE_ZIPS:
+			case TINYEXR_COMPRESSIONTYPE_ZIP:
+			{
+				unsigned long decompressedSize = static_cast<unsigned long>(blockSize);
+				decompressedBlock = tinyexr::DecompressZip(decompressed.data(), &decompressedSize, source, static_cast<unsigned long>(dataSize)) &&
+					decompressedSize == blockSize;
+				break;
+			}
+			case TINYEXR_COMPRESSIONTYPE_PIZ:
+				decompressedBlock = tinyexr::DecompressPiz(decompressed.data(), source, blockSize, static_cast<size_t>(dataSize), header->num_channels, header->channels,
+					static_cast<int>(width), static_cast<int>(lineCount));
+				break;
+			default:
+				break;
+			}
+
+			if (!decompressedBlock)
+			{
+				return false;
+			}
+			source = decompressed.data();
+		}
+
+		LineScratch scratch;
+		size_t destinationLineSize = getTexelSize(format) * width;
+		for (uint32_t line = 0; line < lineCount; line++)
+		{
+			//LoadEXR flips decreasing Y files, and the environment maps have always been loaded that way
+			size_t y = static_cast<size_t>(firstLine) + line;
+			if (header->line_order != 0)
+			{
+				y = height - 1 - y;
+			}
+			convertLine(source + line * lineSize, format, pixels + y * destinationLineSize, scratch);
+		}
+		return true;
+	}
+
+	//Each scanline holds every texel of the first channel, then every texel of the next, in the order the header lists them
+	void ExrDecoder::convertLine(const uint8_t* line, VkFormat format, uint8_t* destination, LineScratch& scratch)
+	{
+		//Half channels going to a half image are only interleaved, which is the usual case for an environment map
+		bool halvesOnly = format == VK_FORMAT_R16G16B16A16_SFLOAT;
+		for (const Channel& channel : channels)
+		{
+			halvesOnly = halvesOnly && (!channel.exists || channel.isHalf);
+		}
+		if (halvesOnly)
+		{
+			uint16_t* texels = reinterpret_cast<uint16_t*>(destination);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				if (!channels[c].exists)
+				{
+					for (uint32_t x = 0; x < width; x++)
+					{
+						texels[x * 4 + c] = HALF_ONE;
+					}
+					continue;
+				}
+
+				const uint8_t* samples = line + channels[c].offset * width;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					memcpy(&texels[x * 4 + c], samples + x * sizeof(uint16_t), sizeof(uint16_t));
+				}
+			}
+			return;
+		}
+
+		scratch.halves.resize(width);
+		scratch.values.resize(width);
+		scratch.texels.resize(static_cast<size_t>(width) * 4);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if (!channels[c].exists)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					scratch.texels[x * 4 + c] = 1.0f;
+				}
+				continue;
+			}
+
+			//Copied out first, blocks read from the mapping aren't aligned
+			const uint8_t* samples = line + channels[c].offset * width;
+			if (channels[c].isHalf)
+			{
+				memcpy(scratch.halves.data(), samples, width * sizeof(uint16_t));
+				HdrPacker::unpackHalf(scratch.halves.data(), scratch.values.data(), width);
+			}
+			else
+			{
+				memcpy(scratch.values.data(), samples, width * sizeof(float));
+			}
+			for (uint32_t x = 0; x < width; x++)
+			{
+				scratch.texels[x * 4 + c] = scratch.values[x];
+			}
+		}
+
+		if (format == VK_FORMAT_R16G16B16A16_SFLOAT)
+		{
+			HdrPacker::packHalf(scratch.texels.data(), reinterpret_cast<uint16_t*>(destination), scratch.texels.size());
+		}
+		else if (format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+		{
+			HdrPacker::packSharedExponent(scratch.texels.data(), reinterpret_cast<uint32_t*>(destination), width);
+		}
+		else
+		{
+			memcpy(destination, scratch.texels.data(), scratch.texels.size() * sizeof(float));
+		}
+	}
+
+	ExrDecoder::~ExrDecoder()
+	{
+		if (header)
+		{
+			FreeEXRHeader(header.get());
+		}
+		free(fallbackPixels);
+	}
+}
\ No newline at end of file
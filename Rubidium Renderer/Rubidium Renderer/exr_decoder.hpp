@@ -0,0 +1,75 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+
+#include <Volk/volk.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct _EXRHeader;
+
+namespace rub
+{
+	//Decodes scanline EXRs a compressed block at a time, straight into a caller's buffer in the format the image is uploaded as.
+	//Blocks are independent, so with a thread pool each one decompresses and converts on its own worker without the full float
+	//image tinyexr's LoadEXR builds. Tiled and multipart files, which the environment maps never are, still go through LoadEXR
+	class ExrDecoder
+	{
+	public:
+		ExrDecoder(ThreadPool* threadPool = nullptr);
+		~ExrDecoder();
+
+		ExrDecoder(const ExrDecoder&) = delete;
+		ExrDecoder& operator=(const ExrDecoder&) = delete;
+
+		//Maps the file and reads its header. Returns false after saying why if it isn't an EXR that can be loaded
+		bool open(const std::string& path);
+
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+
+		//Writes width * height RGBA texels as R32G32B32A32_SFLOAT, R16G16B16A16_SFLOAT or E5B9G9R9_UFLOAT_PACK32 with the same channel
+		//mapping as LoadEXR: a single channel is repeated into all four and a missing alpha is 1
+		bool decode(VkFormat format, void* pixels);
+
+	private:
+		//Where a source channel sits in each scanline of a decompressed block
+		struct Channel
+		{
+			size_t offset = 0;
+			bool isHalf = true;
+			bool exists = false;
+		};
+
+		//Per block working space, a line at a time
+		struct LineScratch
+		{
+			std::vector<uint16_t> halves;
+			std::vector<float> values;
+			std::vector<float> texels;
+		};
+
+		ThreadPool* threadPool;
+		MappedFile file;
+		std::unique_ptr<_EXRHeader> header;
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		//Filled by open() when the file needs the LoadEXR path
+		float* fallbackPixels = nullptr;
+
+		Channel channels[4];
+		//Bytes per texel across every channel in the file, including the ones that aren't loaded
+		size_t texelSize = 0;
+		uint32_t linesPerBlock = 1;
+		std::vector<uint64_t> blockOffsets;
+
+		bool openBlocks(const uint8_t* data, size_t size);
+		bool decodeBlock(uint32_t block, VkFormat format, uint8_t* pixels);
+		void convertLine(const uint8_t* line, VkFormat format, uint8_t* destination, LineScratch& scratch);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "frustum_cull.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace rub
+{
+	Frustum FrustumCull::extractFrustum(const glm::mat4& viewProjection)
+	{
+		//glm is column major, so row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; r++)
+		{
+			rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+		}
+
+		glm::vec4 planes[6] = {
+			rows[3] + rows[0], //Left
+			rows[3] - rows[0], //Right
+			rows[3] + rows[1], //Bottom
+			rows[3] - rows[1], //Top
+			rows[2], //Near
+			rows[3] - rows[2] //Far
+		};
+
+		Frustum frustum{};
+		for (int i = 0; i < 6; i++)
+		{
+			//Normalized so plane distances can be compared against sphere radii directly
+			float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+			frustum.a[i] = planes[i].x / length;
+			frustum.b[i] = planes[i].y / length;
+			frustum.c[i] = planes[i].z / length;
+			frustum.d[i] = planes[i].w / length;
+		}
+
+		return frustum;
+	}
+
+	void FrustumCull::transformSphere(const glm::mat4& modelMatrix, const glm::vec4& sphere, BoundingSpheres& spheres, size_t index)
+	{
+		glm::vec4 center = modelMatrix * glm::vec4(sphere.x, sphere.y, sphere.z, 1.0f);
+		float scaleSquared = std::max(glm::dot(glm::vec3(modelMatrix[0]), glm::vec3(modelMatrix[0])),
+			std::max(glm::dot(glm::vec3(modelMatrix[1]), glm::vec3(modelMatrix[1])), glm::dot(glm::vec3(modelMatrix[2]), glm::vec3(modelMatrix[2]))));
+
+		spheres.centerX[index] = center.x;
+		spheres.centerY[index] = center.y;
+		spheres.centerZ[index] = center.z;
+		spheres.radius[index] = sphere.w * std::sqrt(scaleSquared);
+	}
+
+	size_t FrustumCull::cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visibleIndices)
+	{
+		const size_t count = spheres.size();
+		const float* centerX = spheres.centerX.data();
+		const float* centerY = spheres.centerY.data();
+		const float* centerZ = spheres.centerZ.data();
+		const float* radius = spheres.radius.data();
+
+		size_t visibleCount = 0;
+		size_t i = 0;
+
+#if defined(__AVX__)
+		constexpr size_t WIDTH = 8;
+		__m256 planeA[6], planeB[6], planeC[6], planeD[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeA[p] = _mm256_set1_ps(frustum.a[p]);
+			planeB[p] = _mm256_set1_ps(frustum.b[p]);
+			planeC[p] = _mm256_set1_ps(frustum.c[p]);
+			planeD[p] = _mm256_set1_ps(frustum.d[p]);
+		}
+
+		for (; i + WIDTH <= count; i += WIDTH)
+		{
+			__m256 x = _mm256_loadu_ps(centerX + i);
+			__m256 y = _mm256_loadu_ps(centerY + i);
+			__m256 z = _mm256_loadu_ps(centerZ + i);
+			__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeA[p], x), _mm256_mul_ps(planeB[p], y)),
+					_mm256_add_ps(_mm256_mul_ps(planeC[p], z), planeD[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			//Branchless compaction, every lane is written but only visible ones advance the count
+			for (uint32_t lane = 0; lane < WIDTH; lane++)
+			{
+				visibleIndices[visibleCount] = static_cast<uint32_t>(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+#else
+		constexpr size_t WIDTH = 4;
+		__m128 planeA[6], planeB[6], planeC[6], planeD[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeA[p] = _mm_set1_ps(frustum.a[p]);
+			planeB[p] = _mm_set1_ps(frustum.b[p]);
+			planeC[p] = _mm_set1_ps(frustum.c[p]);
+			planeD[p] = _mm_set1_ps(frustum.d[p]);
+		}
+
+		for (; i + WIDTH <= count; i += WIDTH)
+		{
+			__m128 x = _mm_loadu_ps(centerX + i);
+			__m128 y = _mm_loadu_ps(centerY + i);
+			__m128 z = _mm_loadu_ps(centerZ + i);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeA[p], x), _mm_mul_ps(planeB[p], y)),
+					_mm_add_ps(_mm_mul_ps(planeC[p], z), planeD[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			//Branchless compaction, every lane is written but only visible ones advance the count
+			for (uint32_t lane = 0; lane < WIDTH; lane++)
+			{
+				visibleIndices[visibleCount] = static_cast<uint32_t>(i + lane);
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+#endif
+
+		//Remaining spheres that don't fill a register
+		for (; i < count; i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6; p++)
+			{
+				float distance = frustum.a[p] * centerX[i] + frustum.b[p] * centerY[i] + frustum.c[p] * centerZ[i] + frustum.d[p];
+				inside = inside && distance >= -radius[i];
+			}
+			if (inside)
+			{
+				visibleIndices[visibleCount++] = static_cast<uint32_t>(i);
+			}
+		}
+
+		return visibleCount;
+	}
+
+	size_t FrustumCull::cullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visibleIndices)
+	{
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < spheres.size(); i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				float distance = frustum.a[p] * spheres.centerX[i] + frustum.b[p] * spheres.centerY[i] + frustum.c[p] * spheres.centerZ[i] + frustum.d[p];
+				inside = distance >= -spheres.radius[i];
+			}
+			if (inside)
+			{
+				visibleIndices[visibleCount++] = static_cast<uint32_t>(i);
+			}
+		}
+
+		return visibleCount;
+	}
+}
\ No newline at end of file
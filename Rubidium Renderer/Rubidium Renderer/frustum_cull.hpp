@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rub
+{
+	//Planes stored as separate coefficient arrays so each one broadcasts straight into a SIMD register.
+	//A point is inside plane i when a[i] * x + b[i] * y + c[i] * z + d[i] >= 0
+	struct Frustum
+	{
+		float a[6];
+		float b[6];
+		float c[6];
+		float d[6];
+	};
+
+	//World space bounding spheres in structure of arrays form
+	struct BoundingSpheres
+	{
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radius;
+
+		void resize(size_t count)
+		{
+			centerX.resize(count);
+			centerY.resize(count);
+			centerZ.resize(count);
+			radius.resize(count);
+		}
+
+		size_t size() const { return radius.size(); }
+	};
+
+	class FrustumCull
+	{
+	public:
+		//Expects a zero to one clip space depth range
+		static Frustum extractFrustum(const glm::mat4& viewProjection);
+		static void transformSphere(const glm::mat4& modelMatrix, const glm::vec4& sphere, BoundingSpheres& spheres, size_t index);
+
+		//Writes the indices of every sphere touching the frustum to visibleIndices, which must hold spheres.size() entries.
+		//Returns the visible count. Tests eight spheres per iteration with AVX, four with SSE
+		static size_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visibleIndices);
+		//Reference version of cullSpheres, one sphere at a time
+		static size_t cullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visibleIndices);
+	};
+}
\ No newline at end of file
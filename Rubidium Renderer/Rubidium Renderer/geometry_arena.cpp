@@ -0,0 +1,107 @@
+#include "geometry_arena.hpp"
+#include "upload_batcher.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace rub
+{
+	GeometryArena::GeometryArena(Device& device, uint32_t vertexStride) : device{ device }, vertexStride{ vertexStride },
+		vertexAllocator{ VERTEX_BUFFER_SIZE / vertexStride }, indexAllocator{ INDEX_BUFFER_SIZE / INDEX_ALIGNMENT }
+	{
+		device.createBuffer(VERTEX_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, vertexBuffer);
+		device.createBuffer(INDEX_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, indexBuffer);
+	}
+
+	uint32_t GeometryArena::allocateVertices(uint32_t count)
+	{
+		uint64_t firstVertex = vertexAllocator.allocate(count);
+		if (firstVertex == RangeAllocator::INVALID)
+		{
+			//Meshes freed in the last few frames may be all that is missing
+			releaseFrees(true);
+			firstVertex = vertexAllocator.allocate(count);
+		}
+		if (firstVertex == RangeAllocator::INVALID)
+		{
+			throw std::runtime_error("failed to allocate " + std::to_string(count) + " vertices, geometry arena is full!");
+		}
+		return static_cast<uint32_t>(firstVertex);
+	}
+
+	VkDeviceSize GeometryArena::allocateIndices(VkDeviceSize size)
+	{
+		uint64_t units = (size + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT;
+		uint64_t offset = indexAllocator.allocate(units);
+		if (offset == RangeAllocator::INVALID)
+		{
+			releaseFrees(true);
+			offset = indexAllocator.allocate(units);
+		}
+		if (offset == RangeAllocator::INVALID)
+		{
+			throw std::runtime_error("failed to allocate " + std::to_string(size) + " bytes of indices, geometry arena is full!");
+		}
+		return offset * INDEX_ALIGNMENT;
+	}
+
+	void GeometryArena::free(uint32_t firstVertex, VkDeviceSize indexOffset, uint64_t uploadValue)
+	{
+		std::lock_guard<std::mutex> lock{ pendingMutex };
+		pendingFrees.push_back({ firstVertex, indexOffset, uploadValue, frameCount + 1 });
+	}
+
+	void GeometryArena::beginFrame(uint64_t frameCount, uint64_t completedFrameCount)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ pendingMutex };
+			this->frameCount = frameCount;
+			this->completedFrameCount = completedFrameCount;
+		}
+		releaseFrees(false);
+	}
+
+	void GeometryArena::releaseFrees(bool waitIdle)
+	{
+		std::lock_guard<std::mutex> lock{ pendingMutex };
+		if (pendingFrees.empty())
+		{
+			return;
+		}
+
+		//Only worth it when an allocation would fail otherwise, an idle device has finished every frame and upload
+		if (waitIdle)
+		{
+			vkDeviceWaitIdle(device.getDevice());
+		}
+
+		UploadBatcher& uploadBatcher = device.getUploadBatcher();
+		for (size_t i = 0; i < pendingFrees.size();)
+		{
+			PendingFree& pending = pendingFrees[i];
+			if (!waitIdle && (pending.frameCount > completedFrameCount || !uploadBatcher.isComplete(pending.uploadValue)))
+			{
+				i++;
+				continue;
+			}
+
+			vertexAllocator.free(pending.firstVertex);
+			indexAllocator.free(pending.indexOffset / INDEX_ALIGNMENT);
+			pendingFrees[i] = pendingFrees.back();
+			pendingFrees.pop_back();
+		}
+	}
+
+	void GeometryArena::bind(VkCommandBuffer commandBuffer, VkIndexType indexType)
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, indexType);
+	}
+
+	GeometryArena::~GeometryArena()
+	{
+		vmaDestroyBuffer(device.getAllocator(), vertexBuffer.buffer, vertexBuffer.allocation);
+		vmaDestroyBuffer(device.getAllocator(), indexBuffer.buffer, indexBuffer.allocation);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "device.hpp"
+#include "range_allocator.hpp"
+
+#include <mutex>
+#include <vector>
+
+namespace rub
+{
+	//Vertices and indices of every mesh, suballocated from one device local vertex buffer and one index buffer so a frame binds
+	//them once and draws only differ by firstIndex and vertexOffset. Freed ranges are held back until every frame that could still
+	//draw them and the upload that filled them have finished on the GPU
+	class GeometryArena
+	{
+	public:
+		static constexpr VkDeviceSize VERTEX_BUFFER_SIZE = 128ull << 20;
+		static constexpr VkDeviceSize INDEX_BUFFER_SIZE = 64ull << 20;
+
+		//Vertex space is handed out in whole vertices of vertexStride bytes, so an offset into it is directly a vertexOffset
+		GeometryArena(Device& device, uint32_t vertexStride);
+		~GeometryArena();
+
+		GeometryArena(const GeometryArena&) = delete;
+		GeometryArena& operator=(const GeometryArena&) = delete;
+
+		//Returns the first vertex of the range. Throws once the arena is full, after waiting out any ranges that are still held back
+		uint32_t allocateVertices(uint32_t count);
+		//Returns the byte offset of the range, 4 byte aligned so it suits either index type
+		VkDeviceSize allocateIndices(VkDeviceSize size);
+		//Returns a mesh's vertex and index ranges once the frame being recorded and uploadValue have completed. Safe from any thread
+		void free(uint32_t firstVertex, VkDeviceSize indexOffset, uint64_t uploadValue);
+
+		//Call once a frame after its fence wait. frameCount is the number of frames submitted so far, completedFrameCount how many
+		//of them the GPU has finished
+		void beginFrame(uint64_t frameCount, uint64_t completedFrameCount);
+
+		//Vertex buffer to binding 0 and the index buffer, read as indexType
+		void bind(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+		VkBuffer getVertexBuffer() const { return vertexBuffer.buffer; }
+		VkBuffer getIndexBuffer() const { return indexBuffer.buffer; }
+		uint32_t getVertexStride() const { return vertexStride; }
+
+	private:
+		static constexpr VkDeviceSize INDEX_ALIGNMENT = 4;
+
+		struct PendingFree
+		{
+			uint32_t firstVertex;
+			VkDeviceSize indexOffset;
+			uint64_t uploadValue;
+			//The frame count that has to complete first, the frame being recorded when the mesh was freed
+			uint64_t frameCount;
+		};
+
+		Device& device;
+		uint32_t vertexStride;
+
+		AllocatedBuffer vertexBuffer;
+		AllocatedBuffer indexBuffer;
+		RangeAllocator vertexAllocator;
+		RangeAllocator indexAllocator;
+
+		std::mutex pendingMutex;
+		std::vector<PendingFree> pendingFrees;
+		uint64_t frameCount = 0;
+		uint64_t completedFrameCount = 0;
+
+		void releaseFrees(bool waitIdle);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+namespace rub
+{
+	static constexpr uint64_t PRIME1 = 11400714785074694791ull;
+	static constexpr uint64_t PRIME2 = 14029467366897019727ull;
+	static constexpr uint64_t PRIME3 = 1609587929392839161ull;
+	static constexpr uint64_t PRIME4 = 9650029242287828579ull;
+	static constexpr uint64_t PRIME5 = 2870177450012600261ull;
+
+	static uint64_t rotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	static uint64_t read64(const uint8_t* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static uint32_t read32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static uint64_t round(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * PRIME2;
+		accumulator = rotateLeft(accumulator, 31);
+		return accumulator * PRIME1;
+	}
+
+	static uint64_t mergeRound(uint64_t hash, uint64_t accumulator)
+	{
+		hash ^= round(0, accumulator);
+		return hash * PRIME1 + PRIME4;
+	}
+
+	uint64_t Hash::bytes(const void* data, size_t length, uint64_t seed)
+	{
+		const uint8_t* input = static_cast<const uint8_t*>(data);
+		const uint8_t* end = input + length;
+		uint64_t hash;
+
+		if (length >= 32)
+		{
+			//Four independent lanes so the multiplies overlap
+			uint64_t lane1 = seed + PRIME1 + PRIME2;
+			uint64_t lane2 = seed + PRIME2;
+			uint64_t lane3 = seed;
+			uint64_t lane4 = seed - PRIME1;
+			for (; input + 32 <= end; input += 32)
+			{
+				lane1 = round(lane1, read64(input));
+				lane2 = round(lane2, read64(input + 8));
+				lane3 = round(lane3, read64(input + 16));
+				lane4 = round(lane4, read64(input + 24));
+			}
+
+			hash = rotateLeft(lane1, 1) + rotateLeft(lane2, 7) + rotateLeft(lane3, 12) + rotateLeft(lane4, 18);
+			hash = mergeRound(hash, lane1);
+			hash = mergeRound(hash, lane2);
+			hash = mergeRound(hash, lane3);
+			hash = mergeRound(hash, lane4);
+		}
+		else
+		{
+			hash = seed + PRIME5;
+		}
+
+		hash += length;
+
+		for (; input + 8 <= end; input += 8)
+		{
+			hash ^= round(0, read64(input));
+			hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+		}
+		if (input + 4 <= end)
+		{
+			hash ^= read32(input) * PRIME1;
+			hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+			input += 4;
+		}
+		for (; input < end; input++)
+		{
+			hash ^= *input * PRIME5;
+			hash = rotateLeft(hash, 11) * PRIME1;
+		}
+
+		//Final avalanche so every input bit affects every output bit
+		hash ^= hash >> 33;
+		hash *= PRIME2;
+		hash ^= hash >> 29;
+		hash *= PRIME3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+}
\ No newline at end of file
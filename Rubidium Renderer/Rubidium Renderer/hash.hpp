@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rub
+{
+	class Hash
+	{
+	public:
+		//XXH64, fast on large inputs and well distributed in every bit
+		static uint64_t bytes(const void* data, size_t length, uint64_t seed = 0);
+		//Murmur3's 64 bit finalizer, for hashing values that already fit in a word
+		static uint64_t mix(uint64_t value)
+		{
+			value ^= value >> 33;
+			value *= 0xff51afd7ed558ccdull;
+			value ^= value >> 33;
+			value *= 0xc4ceb9fe1a85ec53ull;
+			value ^= value >> 33;
+			return value;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "hdr_packer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDR_PACKER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace rub
+{
+	//65504.0f, the largest finite half
+	static constexpr uint32_t MAX_HALF_BITS = 0x477FE000;
+	//2^-14, anything below is a half subnormal
+	static constexpr uint32_t MIN_NORMAL_HALF_BITS = 0x38800000;
+	//0.5f, adding it to a half subnormal lines the half's last mantissa bit up with the float's and lets the FPU do the rounding
+	static constexpr uint32_t SUBNORMAL_MAGIC_BITS = 0x3F000000;
+	//Moves the exponent from the float bias to the half one, plus the rounding bias below the 13 dropped mantissa bits
+	static constexpr uint32_t HALF_REBIAS = 0xC8000FFF;
+
+	//(2^9 - 1) / 2^9 * 2^16, the largest value E5B9G9R9 holds
+	static constexpr float MAX_SHARED_EXPONENT_VALUE = 65408.0f;
+	static constexpr uint32_t MANTISSA_BITS = 9;
+	//The float exponent bias less the shared exponent's bias and one, so 2^-16 and below share the smallest exponent
+	static constexpr int32_t SHARED_EXPONENT_OFFSET = 127 - 15 - 1;
+	//A float with this exponent less the shared one is the scale that turns a value into its 9 bit mantissa
+	static constexpr int32_t MANTISSA_SCALE_EXPONENT = 127 + 15 + MANTISSA_BITS;
+
+	static uint16_t packHalfScalar(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = bits & 0x80000000;
+		bits ^= sign;
+		if (bits > 0x7F800000)
+		{
+			return 0;
+		}
+		bits = std::min(bits, MAX_HALF_BITS);
+
+		uint32_t half;
+		if (bits < MIN_NORMAL_HALF_BITS)
+		{
+			float subnormal;
+			memcpy(&subnormal, &bits, sizeof(subnormal));
+			float magic;
+			memcpy(&magic, &SUBNORMAL_MAGIC_BITS, sizeof(magic));
+			subnormal += magic;
+			memcpy(&half, &subnormal, sizeof(half));
+			half -= SUBNORMAL_MAGIC_BITS;
+		}
+		else
+		{
+			//Adding the odd bit on top of the bias rounds ties to even
+			uint32_t odd = (bits >> 13) & 1;
+			half = (bits + HALF_REBIAS + odd) >> 13;
+		}
+		return static_cast<uint16_t>(half | (sign >> 16));
+	}
+
+	//2^112, moves a half exponent shifted into float position over to the float bias. Half subnormals come out normalised
+	static constexpr uint32_t HALF_UNBIAS_BITS = 0x77800000;
+	//The largest finite half without its sign, anything above is an infinity or NaN
+	static constexpr uint32_t MAX_FINITE_HALF = 0x7BFF;
+
+	static float unpackHalfScalar(uint16_t half)
+	{
+		uint32_t magnitude = half & 0x7FFF;
+		uint32_t bits = magnitude << 13;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		float unbias;
+		memcpy(&unbias, &HALF_UNBIAS_BITS, sizeof(unbias));
+		value *= unbias;
+		memcpy(&bits, &value, sizeof(bits));
+		if (magnitude > MAX_FINITE_HALF)
+		{
+			bits |= 0x7F800000;
+		}
+		bits |= static_cast<uint32_t>(half & 0x8000) << 16;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	static float exponentToFloat(int32_t exponent)
+	{
+		uint32_t bits = static_cast<uint32_t>(exponent) << 23;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//floor(value + 0.5), with the fraction compared instead of added since adding 0.5f rounds values just under a half up
+	static uint32_t roundMantissa(float value)
+	{
+		uint32_t mantissa = static_cast<uint32_t>(value);
+		return value - static_cast<float>(mantissa) >= 0.5f ? mantissa + 1 : mantissa;
+	}
+
+	static uint32_t packSharedExponentScalar(const float* texel)
+	{
+		//Written so NaNs fail the comparison and become 0
+		float rgb[3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			rgb[c] = texel[c] > 0.0f ? std::min(texel[c], MAX_SHARED_EXPONENT_VALUE) : 0.0f;
+		}
+		float maxValue = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+
+		uint32_t maxBits;
+		memcpy(&maxBits, &maxValue, sizeof(maxBits));
+		int32_t exponent = std::max(static_cast<int32_t>(maxBits >> 23) - SHARED_EXPONENT_OFFSET, 0);
+		float scale = exponentToFloat(MANTISSA_SCALE_EXPONENT - exponent);
+		//Rounding the largest channel up can carry into a tenth bit, which the next exponent up has room for
+		if (roundMantissa(maxValue * scale) == 1u << MANTISSA_BITS)
+		{
+			exponent++;
+			scale = exponentToFloat(MANTISSA_SCALE_EXPONENT - exponent);
+		}
+
+		uint32_t packed = static_cast<uint32_t>(exponent) << 27;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			packed |= roundMantissa(rgb[c] * scale) << (c * MANTISSA_BITS);
+		}
+		return packed;
+	}
+
+#if defined(HDR_PACKER_SSE2)
+	static __m128i roundMantissas(__m128 values, __m128 half)
+	{
+		__m128i truncated = _mm_cvttps_epi32(values);
+		//The comparison is -1 where the fraction reaches a half, subtracting it rounds those up
+		__m128 fraction = _mm_sub_ps(values, _mm_cvtepi32_ps(truncated));
+		return _mm_sub_epi32(truncated, _mm_castps_si128(_mm_cmpge_ps(fraction, half)));
+	}
+#endif
+
+	void HdrPacker::packHalf(const float* values, uint16_t* halves, size_t count)
+	{
+		size_t i = 0;
+#if defined(HDR_PACKER_SSE2)
+		const __m128i signMask = _mm_set1_epi32(static_cast<int>(0x80000000));
+		const __m128 maxHalf = _mm_castsi128_ps(_mm_set1_epi32(MAX_HALF_BITS));
+		const __m128i minNormal = _mm_set1_epi32(MIN_NORMAL_HALF_BITS);
+		const __m128i magicBits = _mm_set1_epi32(SUBNORMAL_MAGIC_BITS);
+		const __m128i rebias = _mm_set1_epi32(static_cast<int>(HALF_REBIAS));
+		const __m128i one = _mm_set1_epi32(1);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 value = _mm_loadu_ps(values + i);
+			value = _mm_and_ps(value, _mm_cmpord_ps(value, value));
+			__m128i bits = _mm_castps_si128(value);
+			__m128i sign = _mm_and_si128(bits, signMask);
+			__m128 magnitude = _mm_min_ps(_mm_castsi128_ps(_mm_xor_si128(bits, sign)), maxHalf);
+			bits = _mm_castps_si128(magnitude);
+
+			__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(magnitude, _mm_castsi128_ps(magicBits))), magicBits);
+			__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), one);
+			__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, rebias), odd), 13);
+			__m128i isSubnormal = _mm_cmplt_epi32(bits, minNormal);
+			__m128i half = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+			half = _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+
+			//The pack saturates as signed, so the sign bit is spread through the top half first to keep the low 16 bits as they are
+			half = _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(halves + i), _mm_packs_epi32(half, half));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			halves[i] = packHalfScalar(values[i]);
+		}
+	}
+
+	void HdrPacker::packSharedExponent(const float* texels, uint32_t* packed, size_t texelCount)
+	{
+		size_t i = 0;
+#if defined(HDR_PACKER_SSE2)
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maxValue = _mm_set1_ps(MAX_SHARED_EXPONENT_VALUE);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128i exponentOffset = _mm_set1_epi32(SHARED_EXPONENT_OFFSET);
+		const __m128i scaleExponent = _mm_set1_epi32(MANTISSA_SCALE_EXPONENT);
+		const __m128i mantissaCarry = _mm_set1_epi32(1 << MANTISSA_BITS);
+		for (; i + 4 <= texelCount; i += 4)
+		{
+			//Four texels in, one channel per register out
+			__m128 r = _mm_loadu_ps(texels + i * 4);
+			__m128 g = _mm_loadu_ps(texels + i * 4 + 4);
+			__m128 b = _mm_loadu_ps(texels + i * 4 + 8);
+			__m128 a = _mm_loadu_ps(texels + i * 4 + 12);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+
+			//maxps returns its second operand when either is NaN, which clamps NaNs to 0
+			r = _mm_min_ps(_mm_max_ps(r, zero), maxValue);
+			g = _mm_min_ps(_mm_max_ps(g, zero), maxValue);
+			b = _mm_min_ps(_mm_max_ps(b, zero), maxValue);
+			__m128 maxChannel = _mm_max_ps(r, _mm_max_ps(g, b));
+
+			//SSE2 has no integer max, so negative exponents are masked off instead
+			__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxChannel), 23), exponentOffset);
+			exponent = _mm_and_si128(exponent, _mm_cmpgt_epi32(exponent, _mm_setzero_si128()));
+			__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(scaleExponent, exponent), 23));
+			__m128i maxMantissa = roundMantissas(_mm_mul_ps(maxChannel, scale), half);
+			//The comparison is -1 where the mantissa carried, subtracting it bumps those exponents
+			exponent = _mm_sub_epi32(exponent, _mm_cmpeq_epi32(maxMantissa, mantissaCarry));
+			scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(scaleExponent, exponent), 23));
+
+			__m128i rs = roundMantissas(_mm_mul_ps(r, scale), half);
+			__m128i gs = roundMantissas(_mm_mul_ps(g, scale), half);
+			__m128i bs = roundMantissas(_mm_mul_ps(b, scale), half);
+			__m128i result = _mm_or_si128(_mm_or_si128(rs, _mm_slli_epi32(gs, MANTISSA_BITS)), _mm_or_si128(_mm_slli_epi32(bs, MANTISSA_BITS * 2), _mm_slli_epi32(exponent, 27)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i), result);
+		}
+#endif
+		for (; i < texelCount; i++)
+		{
+			packed[i] = packSharedExponentScalar(texels + i * 4);
+		}
+	}
+
+	void HdrPacker::unpackHalf(const uint16_t* halves, float* values, size_t count)
+	{
+		size_t i = 0;
+#if defined(HDR_PACKER_SSE2)
+		const __m128i magnitudeMask = _mm_set1_epi32(0x7FFF);
+		const __m128 unbias = _mm_castsi128_ps(_mm_set1_epi32(HALF_UNBIAS_BITS));
+		const __m128i maxFinite = _mm_set1_epi32(MAX_FINITE_HALF);
+		const __m128i infinityExponent = _mm_set1_epi32(0x7F800000);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i half = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(halves + i)), _mm_setzero_si128());
+			__m128i magnitude = _mm_and_si128(half, magnitudeMask);
+			__m128i sign = _mm_slli_epi32(_mm_xor_si128(half, magnitude), 16);
+			__m128i value = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(magnitude, 13)), unbias));
+			value = _mm_or_si128(value, _mm_and_si128(_mm_cmpgt_epi32(magnitude, maxFinite), infinityExponent));
+			_mm_storeu_ps(values + i, _mm_castsi128_ps(_mm_or_si128(value, sign)));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			values[i] = unpackHalfScalar(halves[i]);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rub
+{
+	//Converts float RGBA texels to the smaller formats HDR images are stored in. Four values or texels go through SSE2 at a time
+	//where it's available, with a scalar path for the rest that rounds the same way
+	class HdrPacker
+	{
+	public:
+		//R16G16B16A16_SFLOAT, rounded to nearest even. Values past the half range clamp to its largest finite value and NaNs become 0
+		static void packHalf(const float* values, uint16_t* halves, size_t count);
+		//E5B9G9R9_UFLOAT_PACK32 following the conversion in the Vulkan spec, alpha is dropped and negative values clamp to 0
+		static void packSharedExponent(const float* texels, uint32_t* packed, size_t texelCount);
+		//Exact, infinities and NaNs included
+		static void unpackHalf(const uint16_t* halves, float* values, size_t count);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "ktx2_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace rub
+{
+	static constexpr uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80);
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	//Data format descriptor fields, from the Khronos data format specification
+	static constexpr uint32_t MODEL_BC1A = 128;
+	static constexpr uint32_t MODEL_BC4 = 131;
+	static constexpr uint32_t MODEL_BC5 = 132;
+	static constexpr uint32_t MODEL_BC6H = 133;
+	static constexpr uint32_t MODEL_BC7 = 134;
+	static constexpr uint32_t PRIMARIES_BT709 = 1;
+	static constexpr uint32_t TRANSFER_LINEAR = 1;
+	static constexpr uint32_t TRANSFER_SRGB = 2;
+	static constexpr uint32_t CHANNEL_FLOAT = 0x80;
+
+	bool Ktx2File::open(const std::string& path)
+	{
+		levels.clear();
+		if (!file.open(path) || file.getSize() < sizeof(Ktx2Header))
+		{
+			return false;
+		}
+
+		Ktx2Header header;
+		memcpy(&header, file.getData(), sizeof(Ktx2Header));
+		uint32_t levelCount = std::max(header.levelCount, 1u);
+		bool valid = memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) == 0 && header.supercompressionScheme == 0
+			&& header.pixelWidth > 0 && header.pixelHeight > 0 && header.pixelDepth == 0 && header.layerCount == 0 && header.faceCount == 1
+			&& sizeof(Ktx2Header) + static_cast<uint64_t>(levelCount) * sizeof(Ktx2LevelIndex) <= file.getSize();
+		if (!valid)
+		{
+			file.close();
+			return false;
+		}
+
+		const uint8_t* levelIndex = file.getData() + sizeof(Ktx2Header);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			Ktx2LevelIndex index;
+			memcpy(&index, levelIndex + i * sizeof(Ktx2LevelIndex), sizeof(Ktx2LevelIndex));
+			if (index.byteOffset > file.getSize() || index.byteLength > file.getSize() - index.byteOffset)
+			{
+				file.close();
+				levels.clear();
+				return false;
+			}
+			levels.push_back({ file.getData() + index.byteOffset, index.byteLength });
+		}
+
+		format = header.vkFormat;
+		width = header.pixelWidth;
+		height = header.pixelHeight;
+		return true;
+	}
+
+	std::string Ktx2File::getCookedPath(const std::string& sourcePath)
+	{
+		return std::filesystem::path(sourcePath).replace_extension(".ktx2").string();
+	}
+
+	uint32_t Ktx2File::getBlockSize(uint32_t format)
+	{
+		switch (format)
+		{
+		case BC1_RGB_UNORM:
+		case BC1_RGB_SRGB:
+		case BC4_UNORM:
+			return 8;
+		case BC5_UNORM:
+		case BC6H_UFLOAT:
+		case BC7_UNORM:
+		case BC7_SRGB:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	//Basic data format descriptor block with one sample per 64 bits of the block
+	static std::vector<uint32_t> describeFormat(uint32_t format)
+	{
+		uint32_t model;
+		uint32_t channelType = 0;
+		uint32_t lower = 0;
+		uint32_t upper = UINT32_MAX;
+		switch (format)
+		{
+		case Ktx2File::BC1_RGB_UNORM:
+		case Ktx2File::BC1_RGB_SRGB:
+			model = MODEL_BC1A;
+			break;
+		case Ktx2File::BC4_UNORM:
+			model = MODEL_BC4;
+			break;
+		case Ktx2File::BC5_UNORM:
+			model = MODEL_BC5;
+			break;
+		case Ktx2File::BC6H_UFLOAT:
+			model = MODEL_BC6H;
+			channelType = CHANNEL_FLOAT;
+			upper = 0x7F800000; //Infinity, the format has no upper bound
+			break;
+		default:
+			model = MODEL_BC7;
+			break;
+		}
+		uint32_t transfer = format == Ktx2File::BC1_RGB_SRGB || format == Ktx2File::BC7_SRGB ? TRANSFER_SRGB : TRANSFER_LINEAR;
+		uint32_t blockSize = Ktx2File::getBlockSize(format);
+
+		//BC5 keeps red and green in separate halves, every other format is described as one sample covering the whole block
+		std::vector<uint32_t> samples;
+		if (format == Ktx2File::BC5_UNORM)
+		{
+			samples = { 0 | (63u << 16), 0, lower, upper, 64 | (63u << 16) | (1u << 24), 0, lower, upper };
+		}
+		else
+		{
+			samples = { 0 | ((blockSize * 8 - 1) << 16) | (channelType << 24), 0, lower, upper };
+		}
+
+		uint32_t descriptorBlockSize = 24 + static_cast<uint32_t>(samples.size()) * 4;
+		std::vector<uint32_t> descriptor = {
+			4 + descriptorBlockSize,
+			0,
+			2 | (descriptorBlockSize << 16),
+			model | (PRIMARIES_BT709 << 8) | (transfer << 16),
+			3 | (3 << 8),
+			blockSize,
+			0
+		};
+		descriptor.insert(descriptor.end(), samples.begin(), samples.end());
+		return descriptor;
+	}
+
+	bool Ktx2File::write(const std::string& path, uint32_t format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels)
+	{
+		uint32_t blockSize = getBlockSize(format);
+		if (blockSize == 0 || levels.empty())
+		{
+			return false;
+		}
+
+		std::vector<uint32_t> descriptor = describeFormat(format);
+
+		Ktx2Header header{};
+		memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+		header.vkFormat = format;
+		header.typeSize = 1;
+		header.pixelWidth = width;
+		header.pixelHeight = height;
+		header.faceCount = 1;
+		header.levelCount = static_cast<uint32_t>(levels.size());
+		header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2LevelIndex));
+		header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+		//Levels are stored smallest first, each aligned to the block size
+		std::vector<Ktx2LevelIndex> levelIndex(levels.size());
+		uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+		for (size_t i = levels.size(); i-- > 0;)
+		{
+			offset = (offset + blockSize - 1) / blockSize * blockSize;
+			levelIndex[i] = { offset, levels[i].size(), levels[i].size() };
+			offset += levels[i].size();
+		}
+
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+			output.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+			output.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+			output.write(reinterpret_cast<const char*>(descriptor.data()), header.dfdByteLength);
+			uint64_t written = header.dfdByteOffset + header.dfdByteLength;
+			const char padding[16] = {};
+			for (size_t i = levels.size(); i-- > 0;)
+			{
+				output.write(padding, levelIndex[i].byteOffset - written);
+				output.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+				written = levelIndex[i].byteOffset + levels[i].size();
+			}
+			if (!output)
+			{
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rub
+{
+	//Single layer 2D KTX2 containers without supercompression, the format the texture cooker writes block compressed textures in.
+	//Formats are stored as VkFormat values but kept as plain integers, so the cooker builds without the Vulkan headers
+	class Ktx2File
+	{
+	public:
+		struct Level
+		{
+			const uint8_t* data;
+			uint64_t size;
+		};
+
+		//VkFormat values the writer knows how to describe
+		enum Format : uint32_t
+		{
+			BC1_RGB_UNORM = 131,
+			BC1_RGB_SRGB = 132,
+			BC4_UNORM = 139,
+			BC5_UNORM = 141,
+			BC6H_UFLOAT = 143,
+			BC7_UNORM = 145,
+			BC7_SRGB = 146
+		};
+
+		Ktx2File() {}
+
+		Ktx2File(const Ktx2File&) = delete;
+		Ktx2File& operator=(const Ktx2File&) = delete;
+
+		//Maps the file and checks every level lies inside it. Levels point into the mapping and stay valid as long as this object does
+		bool open(const std::string& path);
+
+		uint32_t getFormat() const { return format; }
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+		uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+		const Level& getLevel(uint32_t level) const { return levels[level]; }
+
+		//Cooked textures sit beside their source with the extension swapped, which is where the renderer looks for them
+		static std::string getCookedPath(const std::string& sourcePath);
+		//Bytes per 4x4 block, 0 for formats the writer doesn't know
+		static uint32_t getBlockSize(uint32_t format);
+		//levels[0] is the full size image. Written beside the real file and renamed over it like the mesh cache
+		static bool write(const std::string& path, uint32_t format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels);
+
+	private:
+		MappedFile file;
+		uint32_t format = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<Level> levels;
+	};
+}
\ No newline at end of file
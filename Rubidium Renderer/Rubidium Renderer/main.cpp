@@ -1,7 +1,13 @@
 #include "app.hpp"
+#include "benchmark.hpp"
 
-int main()
+int main(int argc, char* argv[])
 {
+	if (rub::Benchmark::run(argc, argv))
+	{
+		return EXIT_SUCCESS;
+	}
+
 	//HelloTriangleApplication app;
 	rub::RubApp app;
 
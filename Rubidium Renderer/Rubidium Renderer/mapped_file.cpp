@@ -0,0 +1,107 @@
+#include "mapped_file.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rub
+{
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		fileHandle = file;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		size = static_cast<size_t>(fileSize.QuadPart);
+
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr)
+		{
+			close();
+			return false;
+		}
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+		fileDescriptor = ::open(path.c_str(), O_RDONLY);
+		if (fileDescriptor < 0)
+		{
+			return false;
+		}
+
+		struct stat fileStat;
+		if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		size = static_cast<size_t>(fileStat.st_size);
+
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		data = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+#endif
+
+		if (data == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+#if defined(_WIN32)
+		if (data != nullptr)
+		{
+			UnmapViewOfFile(data);
+		}
+		if (mappingHandle != nullptr)
+		{
+			CloseHandle(mappingHandle);
+		}
+		if (fileHandle != nullptr)
+		{
+			CloseHandle(fileHandle);
+		}
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (data != nullptr)
+		{
+			munmap(const_cast<uint8_t*>(data), size);
+		}
+		if (fileDescriptor >= 0)
+		{
+			::close(fileDescriptor);
+		}
+		fileDescriptor = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rub
+{
+	//Read only memory mapping of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() {}
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		//Returns false if the file doesn't exist or can't be mapped
+		bool open(const std::string& path);
+		void close();
+
+		const uint8_t* getData() const { return data; }
+		size_t getSize() const { return size; }
+
+	private:
+#if defined(_WIN32)
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+}
\ No newline at end of file
@@ -4,7 +4,11 @@
 
 namespace rub
 {
-	Material::Material(Device& device, const std::string& vertexPath, const std::string& fragPath) : device{ device }, vertPath{ vertexPath }, fragPath{ fragPath }
+	std::atomic<uint32_t> Material::nextId{ 0 };
+	std::map<Material::PipelineKey, std::weak_ptr<Pipeline>> Material::pipelineCache;
+	std::mutex Material::pipelineCacheMutex;
+
+	Material::Material(Device& device, const std::string& vertexPath, const std::string& fragPath) : device{ device }, id{ nextId++ }, vertPath{ vertexPath }, fragPath{ fragPath }
 	{
 
 	}
@@ -14,11 +18,23 @@ namespace rub
 		textures.push_back(texture);
 	}
 
+	bool Material::areTexturesReady()
+	{
+		for (std::shared_ptr<Texture>& texture : textures)
+		{
+			if (!texture->isReady())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
 	void Material::setup(std::vector<VkDescriptorSetLayout>& setLayouts, VkRenderPass renderPass)
 	{
 		createDescriptorSetLayout();
 		createPipelineLayout(setLayouts);
-		createPipeline(renderPass);
+		createPipeline(setLayouts, renderPass);
 	}
 
 	void Material::createDescriptorSetLayout()
@@ -79,8 +95,17 @@ namespace rub
 		vkCreatePipelineLayout(device.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout);
 	}
 
-	void Material::createPipeline(VkRenderPass renderPass)
+	void Material::createPipeline(std::vector<VkDescriptorSetLayout>& setLayouts, VkRenderPass renderPass)
 	{
+		PipelineKey key{ vertPath, fragPath, cullMode, depthCompareOp, modelMatrixOnly, textures.size(), setLayouts, renderPass };
+
+		std::lock_guard<std::mutex> lock(pipelineCacheMutex);
+		pipeline = pipelineCache[key].lock();
+		if (pipeline != nullptr)
+		{
+			return;
+		}
+
 		PipelineConfigInfo pipelineConfig{};
 		Pipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = renderPass;
@@ -88,12 +113,24 @@ namespace rub
 		pipelineConfig.pipelineLayout = pipelineLayout;
 		pipelineConfig.depthStencilInfo.depthCompareOp = depthCompareOp;
 		pipelineConfig.rasterizationInfo.cullMode = cullMode;
-		pipeline = std::make_unique<Pipeline>(device, vertPath, fragPath, pipelineConfig);
+		pipelineConfig.modelMatrixOnly = modelMatrixOnly;
+		pipeline = std::make_shared<Pipeline>(device, vertPath, fragPath, pipelineConfig);
+		pipelineCache[key] = pipeline;
 	}
 
 	void Material::bind(VkCommandBuffer commandBuffer)
+	{
+		bindPipeline(commandBuffer);
+		bindTextures(commandBuffer);
+	}
+
+	void Material::bindPipeline(VkCommandBuffer commandBuffer)
 	{
 		pipeline->bind(commandBuffer);
+	}
+
+	void Material::bindTextures(VkCommandBuffer commandBuffer)
+	{
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, descriptorSetCount - 1, 1, &textureDescriptor, 0, nullptr);
 	}
 
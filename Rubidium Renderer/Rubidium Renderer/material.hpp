@@ -4,7 +4,11 @@
 #include "texture.hpp"
 #include "pipeline.hpp"
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <tuple>
 
 namespace rub
 {
@@ -16,19 +20,54 @@ namespace rub
 
 		void addTexture(std::shared_ptr<Texture> texture);
 		bool isReady() { return pipelineLayout != nullptr && pipeline != nullptr; };
+		//Setup writes the texture descriptors, so it has to wait for every texture to be uploaded
+		bool areTexturesReady();
 		void setup(std::vector<VkDescriptorSetLayout>& setLayouts, VkRenderPass renderPass);
 		void bind(VkCommandBuffer commandBuffer);
+		void bindPipeline(VkCommandBuffer commandBuffer);
+		void bindTextures(VkCommandBuffer commandBuffer);
 		VkPipelineLayout getLayout() { return pipelineLayout; };
+		uint32_t getId() const { return id; }
+		uint32_t getPipelineId() const { return pipeline->getId(); }
 		void setDepthCompareOp(VkCompareOp compareOp) { depthCompareOp = compareOp; }
 		void setCullMode(VkCullModeFlags mode) { cullMode = mode; }
+		//The object buffer holds model matrices alone, so the vertex shader applies the camera itself
+		void setModelMatrixOnly(bool enabled) { modelMatrixOnly = enabled; }
 		
 	private:
+		//Everything a pipeline is built from. The texture set layout only varies with the number of textures, so materials that match
+		//here have compatible layouts and can bind each other's pipeline
+		struct PipelineKey
+		{
+			std::string vertPath;
+			std::string fragPath;
+			VkCullModeFlags cullMode;
+			VkCompareOp depthCompareOp;
+			bool modelMatrixOnly;
+			size_t textureCount;
+			std::vector<VkDescriptorSetLayout> setLayouts;
+			VkRenderPass renderPass;
+
+			bool operator<(const PipelineKey& other) const
+			{
+				return std::tie(vertPath, fragPath, cullMode, depthCompareOp, modelMatrixOnly, textureCount, setLayouts, renderPass) <
+					std::tie(other.vertPath, other.fragPath, other.cullMode, other.depthCompareOp, other.modelMatrixOnly, other.textureCount, other.setLayouts, other.renderPass);
+			}
+		};
+
 		void createBuffers();
 		void createDescriptorSetLayout();
 		void createPipelineLayout(std::vector<VkDescriptorSetLayout>& setLayouts);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(std::vector<VkDescriptorSetLayout>& setLayouts, VkRenderPass renderPass);
 
 		Device& device;
+		const uint32_t id;
+
+		static std::atomic<uint32_t> nextId;
+		//Pipelines are shared between materials so the draw sort can group them and consecutive draws skip the bind.
+		//Entries expire once the last material using them is destroyed
+		static std::map<PipelineKey, std::weak_ptr<Pipeline>> pipelineCache;
+		static std::mutex pipelineCacheMutex;
 
 		std::string vertPath;
 		std::string fragPath;
@@ -39,11 +78,12 @@ namespace rub
 		VkDescriptorSetLayout textureSetLayout;
 		VkDescriptorSet textureDescriptor;
 
-		std::unique_ptr<Pipeline> pipeline;
+		std::shared_ptr<Pipeline> pipeline;
 		VkPipelineLayout pipelineLayout;
 		int descriptorSetCount = 0;
 
 		VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
 		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		bool modelMatrixOnly = false;
 	};
 }
\ No newline at end of file
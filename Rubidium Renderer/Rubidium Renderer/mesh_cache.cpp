@@ -0,0 +1,167 @@
+#include "mesh_cache.hpp"
+
+#include "hash.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace rub
+{
+	MeshCache::MeshCache(const std::string& sourcePath, uint32_t vertexStride, uint32_t processFlags) :
+		sourcePath{ sourcePath }, vertexStride{ vertexStride }, processFlags{ processFlags }
+	{
+		std::stringstream name;
+		name << std::hex << std::setw(16) << std::setfill('0') << Hash::bytes(sourcePath.data(), sourcePath.size()) << ".mesh";
+		cachePath = (std::filesystem::path(CACHE_DIRECTORY) / name.str()).string();
+
+		std::error_code error;
+		sourceSize = std::filesystem::file_size(sourcePath, error);
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(sourcePath, error);
+		sourceExists = !error;
+		sourceTime = sourceExists ? static_cast<int64_t>(time.time_since_epoch().count()) : 0;
+	}
+
+	bool MeshCache::open(MeshView& mesh)
+	{
+		if (!file.open(cachePath) || file.getSize() < sizeof(Header))
+		{
+			return false;
+		}
+
+		Header header;
+		memcpy(&header, file.getData(), sizeof(Header));
+		bool valid = header.magic == MAGIC && header.version == VERSION && header.vertexStride == vertexStride && header.processFlags == processFlags
+			&& header.vertexOffset + static_cast<uint64_t>(header.vertexCount) * vertexStride <= file.getSize()
+			&& (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t))
+			&& header.indexOffset + static_cast<uint64_t>(header.indexCount) * header.indexSize <= file.getSize()
+			&& header.submeshOffset + static_cast<uint64_t>(header.submeshCount) * sizeof(Submesh) <= file.getSize();
+
+		//A shipped cache without its source is still usable. A source that was only touched is caught by the hash
+		bool touched = valid && sourceExists && (header.sourceSize != sourceSize || header.sourceTime != sourceTime);
+		if (touched)
+		{
+			uint64_t hash;
+			valid = hashSource(hash) && hash == header.sourceHash;
+		}
+
+		if (!valid)
+		{
+			file.close();
+			return false;
+		}
+
+		//The content still matches, so record the new size and time and later loads skip the hash.
+		//The mapping doesn't share write access, so it's closed around the update
+		if (touched)
+		{
+			header.sourceSize = sourceSize;
+			header.sourceTime = sourceTime;
+			file.close();
+			updateHeader(header);
+			if (!file.open(cachePath) || file.getSize() < header.submeshOffset + static_cast<uint64_t>(header.submeshCount) * sizeof(Submesh))
+			{
+				file.close();
+				return false;
+			}
+		}
+
+		mesh.vertices = file.getData() + header.vertexOffset;
+		mesh.vertexCount = header.vertexCount;
+		mesh.indices = file.getData() + header.indexOffset;
+		mesh.indexCount = header.indexCount;
+		mesh.indexSize = header.indexSize;
+		mesh.submeshes = reinterpret_cast<const Submesh*>(file.getData() + header.submeshOffset);
+		mesh.submeshCount = header.submeshCount;
+		mesh.boundsMin = header.boundsMin;
+		mesh.boundsMax = header.boundsMax;
+		mesh.boundingSphere = header.boundingSphere;
+		return true;
+	}
+
+	void MeshCache::write(const MeshView& mesh)
+	{
+		Header header{};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+		header.vertexStride = vertexStride;
+		header.processFlags = processFlags;
+		header.vertexCount = mesh.vertexCount;
+		header.indexCount = mesh.indexCount;
+		header.indexSize = mesh.indexSize;
+		header.submeshCount = mesh.submeshCount;
+		header.boundsMin = mesh.boundsMin;
+		header.boundsMax = mesh.boundsMax;
+		header.boundingSphere = mesh.boundingSphere;
+		if (!hashSource(header.sourceHash))
+		{
+			return;
+		}
+
+		//Vertices start 16 byte aligned in the mapping, indices are naturally 4 byte aligned after them and 16 bit indices are padded
+		//so the submeshes are too
+		uint64_t vertexSize = static_cast<uint64_t>(mesh.vertexCount) * vertexStride;
+		uint64_t indexSize = static_cast<uint64_t>(mesh.indexCount) * mesh.indexSize;
+		header.vertexOffset = (sizeof(Header) + 15) & ~15ull;
+		header.indexOffset = header.vertexOffset + vertexSize;
+		header.submeshOffset = (header.indexOffset + indexSize + 3) & ~3ull;
+
+		std::error_code error;
+		std::filesystem::create_directories(CACHE_DIRECTORY, error);
+
+		//Written beside the real file and renamed over it, so a crash mid write never leaves a truncated cache
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+			std::vector<char> padding(header.vertexOffset - sizeof(Header), 0);
+			output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			output.write(padding.data(), padding.size());
+			output.write(static_cast<const char*>(mesh.vertices), vertexSize);
+			output.write(static_cast<const char*>(mesh.indices), indexSize);
+			const char indexPadding[4] = {};
+			output.write(indexPadding, header.submeshOffset - header.indexOffset - indexSize);
+			output.write(reinterpret_cast<const char*>(mesh.submeshes), sizeof(Submesh) * mesh.submeshCount);
+			if (!output)
+			{
+				std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+				return;
+			}
+		}
+
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error)
+		{
+			std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+			std::filesystem::remove(tempPath, error);
+		}
+	}
+
+	void MeshCache::updateHeader(const Header& header)
+	{
+		//Only the header changes, a failed write just means the next load hashes the source again
+		std::fstream output(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		if (!output)
+		{
+			std::cout << "Failed to update mesh cache: " << cachePath << std::endl;
+		}
+	}
+
+	bool MeshCache::hashSource(uint64_t& hash)
+	{
+		MappedFile source;
+		if (!source.open(sourcePath))
+		{
+			return false;
+		}
+
+		hash = Hash::bytes(source.getData(), source.getSize());
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace rub
+{
+	//Range of the index buffer belonging to one shape of the source file, or to part of one when 16 bit indices forced a split.
+	//vertexOffset is added to every index in the range
+	struct Submesh
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+	};
+
+	//Fully processed meshes stored as one binary file each, so loading is a file map and a copy.
+	//Files live in CACHE_DIRECTORY named after the source path, and are only used while the source's size and
+	//modification time, or failing that its content hash, still match what was recorded
+	class MeshCache
+	{
+	public:
+		//Pointers into either caller owned arrays when writing, or the mapped file when reading
+		struct MeshView
+		{
+			const void* vertices;
+			uint32_t vertexCount;
+			//indexSize bytes each, 2 or 4
+			const void* indices;
+			uint32_t indexCount;
+			uint32_t indexSize;
+			const Submesh* submeshes;
+			uint32_t submeshCount;
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			glm::vec4 boundingSphere;
+		};
+
+		static constexpr const char* CACHE_DIRECTORY = "cache/meshes";
+		//Bump whenever the layout of the file or of anything stored in it changes
+		static constexpr uint32_t VERSION = 5;
+
+		//processFlags describes how the stored mesh was processed, a cache written with different flags is not used
+		MeshCache(const std::string& sourcePath, uint32_t vertexStride, uint32_t processFlags = 0);
+
+		//Maps the cached file if it is still valid for the source. The view stays valid as long as this object does
+		bool open(MeshView& mesh);
+		//Replaces the cached file. Failing to write only costs the next load a reparse, so it isn't an error
+		void write(const MeshView& mesh);
+
+	private:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			uint64_t sourceHash;
+			uint32_t vertexStride;
+			uint32_t processFlags;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t indexSize;
+			uint32_t submeshCount;
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			uint64_t submeshOffset;
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			glm::vec4 boundingSphere;
+		};
+
+		static constexpr uint32_t MAGIC = 0x534D4252; //"RBMS"
+
+		std::string sourcePath;
+		std::string cachePath;
+		uint32_t vertexStride;
+		uint32_t processFlags;
+		uint64_t sourceSize = 0;
+		int64_t sourceTime = 0;
+		bool sourceExists = false;
+
+		MappedFile file;
+
+		bool hashSource(uint64_t& hash);
+		void updateHeader(const Header& header);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace rub
+{
+	MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		//A vertex is in the cache while fewer than cacheSize misses have happened since it was last loaded
+		std::vector<size_t> loadedAt(vertexCount, 0);
+		std::vector<uint8_t> referenced(vertexCount, 0);
+		size_t misses = 0;
+		size_t referencedCount = 0;
+
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			uint32_t vertex = indices[i];
+			if (loadedAt[vertex] == 0 || misses - loadedAt[vertex] >= cacheSize)
+			{
+				misses++;
+				loadedAt[vertex] = misses;
+			}
+
+			referencedCount += referenced[vertex] == 0;
+			referenced[vertex] = 1;
+		}
+
+		CacheStats stats{};
+		stats.acmr = indexCount == 0 ? 0.0f : static_cast<float>(misses) / (indexCount / 3);
+		stats.atvr = referencedCount == 0 ? 0.0f : static_cast<float>(misses) / referencedCount;
+		return stats;
+	}
+
+	void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		//Triangles using each vertex, packed into one array
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			liveTriangles[indices[i]]++;
+		}
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		}
+		std::vector<uint32_t> adjacency(indexCount);
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		uint32_t time = cacheSize + 1;
+		size_t cursor = 0;
+
+		int64_t fanVertex = indices[0];
+		while (fanVertex >= 0)
+		{
+			candidates.clear();
+			for (uint32_t a = adjacencyOffsets[fanVertex]; a < adjacencyOffsets[fanVertex + 1]; a++)
+			{
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				emitted[triangle] = 1;
+
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					output.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+					if (time - cacheTime[vertex] > cacheSize)
+					{
+						cacheTime[vertex] = time;
+						time++;
+					}
+				}
+			}
+
+			//Next fan is the candidate that stays in the cache longest while it's fanned, as long as fanning it
+			//won't push its own vertices out first
+			fanVertex = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0)
+				{
+					continue;
+				}
+
+				int64_t priority = 0;
+				if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+				{
+					priority = time - cacheTime[vertex];
+				}
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					fanVertex = vertex;
+				}
+			}
+
+			//Nothing nearby left, back off to recently touched vertices and then to a linear scan
+			while (fanVertex < 0 && !deadEnds.empty())
+			{
+				uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+				{
+					fanVertex = vertex;
+				}
+			}
+			while (fanVertex < 0 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					fanVertex = static_cast<int64_t>(cursor);
+				}
+				cursor++;
+			}
+		}
+
+		memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	}
+
+	void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+		uint32_t cacheSize)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		auto position = [&](uint32_t vertex)
+		{
+			return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+		};
+
+		//Cluster boundaries go where a triangle misses on all three vertices, since the cache is effectively cold there anyway
+		std::vector<size_t> clusterStarts;
+		std::vector<size_t> loadedAt(vertexCount, 0);
+		size_t misses = 0;
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			int triangleMisses = 0;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				if (loadedAt[vertex] == 0 || misses - loadedAt[vertex] >= cacheSize)
+				{
+					misses++;
+					loadedAt[vertex] = misses;
+					triangleMisses++;
+				}
+			}
+			if (triangle == 0 || triangleMisses == 3)
+			{
+				clusterStarts.push_back(triangle);
+			}
+		}
+		clusterStarts.push_back(triangleCount);
+
+		float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			const float* p = position(indices[i]);
+			meshCenter[0] += p[0];
+			meshCenter[1] += p[1];
+			meshCenter[2] += p[2];
+		}
+		for (float& component : meshCenter)
+		{
+			component /= indexCount;
+		}
+
+		//Occlusion potential is how far the cluster sits out along its own area weighted normal
+		size_t clusterCount = clusterStarts.size() - 1;
+		std::vector<std::pair<float, size_t>> clusterOrder(clusterCount);
+		for (size_t cluster = 0; cluster < clusterCount; cluster++)
+		{
+			float center[3] = { 0.0f, 0.0f, 0.0f };
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			for (size_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++)
+			{
+				const float* a = position(indices[triangle * 3 + 0]);
+				const float* b = position(indices[triangle * 3 + 1]);
+				const float* c = position(indices[triangle * 3 + 2]);
+				float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+				normal[0] += ab[1] * ac[2] - ab[2] * ac[1];
+				normal[1] += ab[2] * ac[0] - ab[0] * ac[2];
+				normal[2] += ab[0] * ac[1] - ab[1] * ac[0];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					center[axis] += a[axis] + b[axis] + c[axis];
+				}
+			}
+
+			size_t clusterTriangles = clusterStarts[cluster + 1] - clusterStarts[cluster];
+			float potential = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				potential += (center[axis] / (clusterTriangles * 3) - meshCenter[axis]) * normal[axis];
+			}
+			clusterOrder[cluster] = { -potential, cluster };
+		}
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		for (const auto& [potential, cluster] : clusterOrder)
+		{
+			output.insert(output.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+		}
+		memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	}
+
+	size_t MeshOptimizer::optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride, uint32_t* indices, size_t indexCount)
+	{
+		constexpr uint32_t UNUSED = UINT32_MAX;
+		std::vector<uint32_t> remap(vertexCount, UNUSED);
+		std::vector<uint8_t> reordered(vertexCount * vertexStride);
+		const uint8_t* source = static_cast<const uint8_t*>(vertices);
+
+		uint32_t nextVertex = 0;
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			uint32_t& newIndex = remap[indices[i]];
+			if (newIndex == UNUSED)
+			{
+				newIndex = nextVertex++;
+				memcpy(reordered.data() + newIndex * vertexStride, source + indices[i] * vertexStride, vertexStride);
+			}
+			indices[i] = newIndex;
+		}
+
+		memcpy(vertices, reordered.data(), nextVertex * vertexStride);
+		return nextVertex;
+	}
+}
\ No newline at end of file
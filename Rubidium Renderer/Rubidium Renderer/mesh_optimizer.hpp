@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rub
+{
+	//Reorders indexed triangle lists for the GPU. All functions work on one triangle list at a time,
+	//so a mesh with submeshes is optimized one index range at a time
+	class MeshOptimizer
+	{
+	public:
+		//Average cache miss ratio, misses per triangle, 0.5 at best and 3 at worst.
+		//Average transform to vertex ratio, misses per referenced vertex, 1 at best
+		struct CacheStats
+		{
+			float acmr;
+			float atvr;
+		};
+
+		static constexpr uint32_t CACHE_SIZE = 16;
+
+		//Simulates a FIFO post transform cache of cacheSize entries
+		static CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		//Tipsify (Sander, Nehab and Barczak 2007). Fans around recently used vertices and falls back to the most
+		//recent dead end when a fan runs out, which reaches close to optimal ACMR in linear time
+		static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		//Splits the cache optimized order into clusters wherever the cache restarts, then draws the clusters facing away
+		//from the mesh center first so they occlude the rest. Costs a little ACMR at the cluster boundaries
+		static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+			uint32_t cacheSize = CACHE_SIZE);
+
+		//Reorders vertices by first use so fetches walk memory forwards, dropping any that are never referenced.
+		//Rewrites indices to match and returns the new vertex count
+		static size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride, uint32_t* indices, size_t indexCount);
+	};
+}
\ No newline at end of file
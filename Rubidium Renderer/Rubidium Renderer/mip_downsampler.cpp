@@ -0,0 +1,273 @@
+#include "mip_downsampler.hpp"
+
+#include "vk_util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace rub
+{
+	static constexpr uint32_t TILE_SIZE = 64;
+	static constexpr VkDeviceSize COUNTERS_SIZE = 32;
+	//Level 6 of a MAX_SIZE image is 64x64
+	static constexpr VkDeviceSize LEVEL6_TEXELS = 64 * 64;
+
+	MipDownsampler::MipDownsampler(Device& device) : device{ device }
+	{
+		createDescriptorSetLayout();
+
+		std::vector<VkDescriptorSetLayout> setLayouts = { setLayout };
+		shader = std::make_unique<ComputeShader>(device, "shaders/spd.comp.spv", setLayouts, sizeof(PushConstants));
+
+		VkSamplerCreateInfo samplerInfo = VkUtil::samplesCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1);
+		vkCreateSampler(device.getDevice(), &samplerInfo, nullptr, &sampler);
+
+		globalBufferSize = COUNTERS_SIZE + MAX_LAYERS * LEVEL6_TEXELS * sizeof(float) * 4;
+		device.createBuffer(globalBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, globalBuffer);
+	}
+
+	void MipDownsampler::createDescriptorSetLayout()
+	{
+		VkDescriptorSetLayoutBinding sourceBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		VkDescriptorSetLayoutBinding mipsBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		mipsBinding.descriptorCount = MAX_LEVELS - 1;
+		VkDescriptorSetLayoutBinding globalBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2);
+		std::vector<VkDescriptorSetLayoutBinding> bindings = { sourceBinding, mipsBinding, globalBinding };
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device.getDevice(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsample descriptor set layout!");
+		}
+	}
+
+	VkDescriptorPool MipDownsampler::createDescriptorPool()
+	{
+		//Sets are freed as their uploads retire, a new pool is only added when a single batch holds more than this
+		const uint32_t setCount = 64;
+		std::vector<VkDescriptorPoolSize> sizes =
+		{
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount * (MAX_LEVELS - 1) },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount }
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+		poolInfo.pPoolSizes = sizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(device.getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsample descriptor pool!");
+		}
+		descriptorPools.push_back(pool);
+		return pool;
+	}
+
+	void MipDownsampler::allocateDescriptorSet(Resources& resources)
+	{
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+
+		for (VkDescriptorPool pool : descriptorPools)
+		{
+			allocInfo.descriptorPool = pool;
+			if (vkAllocateDescriptorSets(device.getDevice(), &allocInfo, &resources.descriptorSet) == VK_SUCCESS)
+			{
+				resources.descriptorPool = pool;
+				return;
+			}
+		}
+
+		allocInfo.descriptorPool = createDescriptorPool();
+		if (vkAllocateDescriptorSets(device.getDevice(), &allocInfo, &resources.descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate downsample descriptor set!");
+		}
+		resources.descriptorPool = allocInfo.descriptorPool;
+	}
+
+	VkFormat MipDownsampler::storageFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_R8G8B8A8_UNORM : format;
+	}
+
+	bool MipDownsampler::isSupported(Device& device, VkFormat format, VkExtent2D extent)
+	{
+		if (!device.supportsStorageImageDownsampling() || std::max(extent.width, extent.height) > MAX_SIZE)
+		{
+			return false;
+		}
+		return device.isFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) &&
+			device.isFormatSupported(storageFormat(format), VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+	}
+
+	VkImageCreateFlags MipDownsampler::imageCreateFlags(VkFormat format)
+	{
+		if (storageFormat(format) != format)
+		{
+			return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+		}
+		return 0;
+	}
+
+	VkImageView MipDownsampler::createView(VkImage image, VkFormat format, uint32_t level, uint32_t layerCount, VkImageUsageFlags usage)
+	{
+		//The image may have usages its own format doesn't support, so each view says which one it's for
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = usage;
+
+		VkImageViewCreateInfo viewInfo = VkUtil::imageViewCreateInfo(format, image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		viewInfo.pNext = &usageInfo;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.layerCount = layerCount;
+
+		VkImageView view;
+		if (vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsample image view!");
+		}
+		return view;
+	}
+
+	void MipDownsampler::record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, uint32_t mipLevels, uint32_t layerCount,
+		VkImageLayout baseLayout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, Resources& resources)
+	{
+		if (mipLevels < 2)
+		{
+			throw std::runtime_error("failed to downsample image, it has no levels past the first!");
+		}
+		if (mipLevels > MAX_LEVELS || layerCount > MAX_LAYERS)
+		{
+			throw std::runtime_error("failed to downsample image, it has too many levels or layers!");
+		}
+
+		resources.views.push_back(createView(image, format, 0, layerCount, VK_IMAGE_USAGE_SAMPLED_BIT));
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			resources.views.push_back(createView(image, storageFormat(format), level, layerCount, VK_IMAGE_USAGE_STORAGE_BIT));
+		}
+		allocateDescriptorSet(resources);
+
+		VkDescriptorImageInfo sourceInfo{};
+		sourceInfo.sampler = sampler;
+		sourceInfo.imageView = resources.views[0];
+		sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		//Every slot needs a valid view, the ones past the last level repeat it and the shader never writes them
+		std::array<VkDescriptorImageInfo, MAX_LEVELS - 1> mipInfos{};
+		for (uint32_t i = 0; i < mipInfos.size(); i++)
+		{
+			mipInfos[i].imageView = resources.views[std::min<size_t>(i + 1, resources.views.size() - 1)];
+			mipInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		VkDescriptorBufferInfo globalInfo{};
+		globalInfo.buffer = globalBuffer.buffer;
+		globalInfo.range = globalBufferSize;
+
+		VkWriteDescriptorSet sourceWrite = VkUtil::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, resources.descriptorSet, &sourceInfo, 0);
+		VkWriteDescriptorSet mipsWrite = VkUtil::writeDescriptorImage(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, resources.descriptorSet, mipInfos.data(), 1);
+		mipsWrite.descriptorCount = static_cast<uint32_t>(mipInfos.size());
+		VkWriteDescriptorSet globalWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, resources.descriptorSet, &globalInfo, 2);
+		std::vector<VkWriteDescriptorSet> writes = { sourceWrite, mipsWrite, globalWrite };
+		vkUpdateDescriptorSets(device.getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		//Level 0 becomes readable and the rest writable. The global buffer is shared by every downsample, so the counters are
+		//only cleared once the previous dispatch is done with it
+		std::array<VkImageMemoryBarrier, 2> toCompute{};
+		toCompute[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toCompute[0].oldLayout = baseLayout;
+		toCompute[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		toCompute[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toCompute[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toCompute[0].image = image;
+		toCompute[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount };
+		toCompute[0].srcAccessMask = srcAccess;
+		toCompute[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		toCompute[1] = toCompute[0];
+		toCompute[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		toCompute[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		toCompute[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, layerCount };
+		toCompute[1].srcAccessMask = 0;
+		toCompute[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+		VkMemoryBarrier previousDispatch{};
+		previousDispatch.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		previousDispatch.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		previousDispatch.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, srcStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &previousDispatch, 0, nullptr, static_cast<uint32_t>(toCompute.size()), toCompute.data());
+
+		vkCmdFillBuffer(commandBuffer, globalBuffer.buffer, 0, COUNTERS_SIZE, 0);
+
+		VkMemoryBarrier countersCleared{};
+		countersCleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		countersCleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		countersCleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &countersCleared, 0, nullptr, 0, nullptr);
+
+		PushConstants constants{};
+		constants.width = extent.width;
+		constants.height = extent.height;
+		constants.mipCount = mipLevels - 1;
+		constants.workGroupCount = ((extent.width + TILE_SIZE - 1) / TILE_SIZE) * ((extent.height + TILE_SIZE - 1) / TILE_SIZE);
+		constants.srgb = storageFormat(format) != format ? 1 : 0;
+
+		shader->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, shader->getLayout(), 0, 1, &resources.descriptorSet, 0, nullptr);
+		shader->pushConstants(commandBuffer, &constants, sizeof(constants));
+		vkCmdDispatch(commandBuffer, (extent.width + TILE_SIZE - 1) / TILE_SIZE, (extent.height + TILE_SIZE - 1) / TILE_SIZE, layerCount);
+
+		//Level 0 keeps its layout, it only has to be made visible to fragment shaders as well
+		std::array<VkImageMemoryBarrier, 2> toReadable = toCompute;
+		toReadable[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		toReadable[0].srcAccessMask = 0;
+		toReadable[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		toReadable[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		toReadable[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		toReadable[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(toReadable.size()), toReadable.data());
+	}
+
+	void MipDownsampler::release(Resources& resources)
+	{
+		for (VkImageView view : resources.views)
+		{
+			vkDestroyImageView(device.getDevice(), view, nullptr);
+		}
+		resources.views.clear();
+
+		if (resources.descriptorSet != VK_NULL_HANDLE)
+		{
+			vkFreeDescriptorSets(device.getDevice(), resources.descriptorPool, 1, &resources.descriptorSet);
+			resources.descriptorSet = VK_NULL_HANDLE;
+		}
+	}
+
+	MipDownsampler::~MipDownsampler()
+	{
+		for (VkDescriptorPool pool : descriptorPools)
+		{
+			vkDestroyDescriptorPool(device.getDevice(), pool, nullptr);
+		}
+		vmaDestroyBuffer(device.getAllocator(), globalBuffer.buffer, globalBuffer.allocation);
+		vkDestroySampler(device.getDevice(), sampler, nullptr);
+		shader.reset();
+		vkDestroyDescriptorSetLayout(device.getDevice(), setLayout, nullptr);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "device.hpp"
+#include "compute_shader.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace rub
+{
+	//Fills every level of an image below the first in one compute dispatch, in the style of AMD's single pass downsampler.
+	//Workgroups reduce 64x64 tiles in shared memory and the last one to finish a layer, found with an atomic counter, reduces
+	//what they left behind, so each level is read once instead of every level being filtered from the top
+	class MipDownsampler
+	{
+	public:
+		//Views and descriptors a recorded downsample uses, they have to live until its commands have completed
+		struct Resources
+		{
+			std::vector<VkImageView> views;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		static constexpr uint32_t MAX_SIZE = 4096;
+		static constexpr uint32_t MAX_LEVELS = 13;
+		static constexpr uint32_t MAX_LAYERS = 6;
+		//The first level is sampled, the rest are written as storage images
+		static constexpr VkImageUsageFlags IMAGE_USAGE = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+
+		MipDownsampler(Device& device);
+		~MipDownsampler();
+
+		MipDownsampler(const MipDownsampler&) = delete;
+		MipDownsampler& operator=(const MipDownsampler&) = delete;
+
+		//Images passing this also need IMAGE_USAGE and imageCreateFlags() to be downsampled
+		static bool isSupported(Device& device, VkFormat format, VkExtent2D extent);
+		//sRGB formats can't be storage images, so their levels are written through a UNORM view of a mutable image
+		static VkImageCreateFlags imageCreateFlags(VkFormat format);
+
+		//Level 0 is moved from baseLayout once srcStage and srcAccess are done with it. Every level ends in shader read only layout.
+		//There has to be at least one level to generate
+		void record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, uint32_t mipLevels, uint32_t layerCount,
+			VkImageLayout baseLayout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, Resources& resources);
+		void release(Resources& resources);
+
+	private:
+		struct PushConstants
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t mipCount;
+			uint32_t workGroupCount;
+			uint32_t srgb;
+		};
+
+		Device& device;
+		VkDescriptorSetLayout setLayout;
+		std::unique_ptr<ComputeShader> shader;
+		VkSampler sampler;
+		//Per layer atomic counters followed by the level 6 texels each workgroup leaves for the last one
+		AllocatedBuffer globalBuffer;
+		VkDeviceSize globalBufferSize;
+		std::vector<VkDescriptorPool> descriptorPools;
+
+		void createDescriptorSetLayout();
+		VkDescriptorPool createDescriptorPool();
+		void allocateDescriptorSet(Resources& resources);
+		VkImageView createView(VkImage image, VkFormat format, uint32_t level, uint32_t layerCount, VkImageUsageFlags usage);
+		static VkFormat storageFormat(VkFormat format);
+	};
+}
\ No newline at end of file
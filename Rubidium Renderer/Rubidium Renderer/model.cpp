@@ -2,178 +2,553 @@
 
 #include <rapidobj/rapidobj.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <functional>
 #include <stdexcept>
-#include <unordered_map>
 #include <iostream>
 
-#include "vk_util.hpp"
+#include "upload_batcher.hpp"
+#include "mesh_optimizer.hpp"
+#include "vertex_dedup.hpp"
 
 namespace rub
 {
-	Model::Model(Device& device, const std::string modelPath) : device{ device }
+	std::atomic<uint32_t> Model::nextId{ 0 };
+
+	Model::Model(Device& device, GeometryArena& geometryArena, const std::string modelPath, ThreadPool* threadPool, Optimization optimization) :
+		device{ device }, geometryArena{ geometryArena }, id{ nextId++ }, threadPool{ threadPool }, optimization{ optimization }
+	{
+		decode(modelPath);
+		upload();
+	}
+
+	Model::Model(Device& device, GeometryArena& geometryArena, Optimization optimization) :
+		device{ device }, geometryArena{ geometryArena }, id{ nextId++ }, threadPool{ nullptr }, optimization{ optimization }
+	{
+
+	}
+
+	void Model::decode(const std::string& modelPath)
+	{
+		pending = std::make_unique<PendingMesh>();
+		MeshCache::MeshView& mesh = pending->mesh;
+
+		//A valid cache is uploaded straight out of the mapping, with no parsing or per vertex work at all
+		pending->cache = std::make_unique<MeshCache>(modelPath, VERTEX_STRIDE, static_cast<uint32_t>(optimization));
+		if (pending->cache->open(mesh))
+		{
+			boundsMin = mesh.boundsMin;
+			boundsMax = mesh.boundsMax;
+			boundingSphere = mesh.boundingSphere;
+			submeshes.assign(mesh.submeshes, mesh.submeshes + mesh.submeshCount);
+
+			std::cout << "Cached mesh: " << modelPath << std::endl;
+			return;
+		}
+
+		std::vector<Vertex>& vertices = pending->vertices;
+		std::vector<uint32_t>& indices = pending->indices;
+		loadOBJ(modelPath, vertices, indices);
+		optimizeMesh(vertices, indices);
+		calculateBounds(vertices);
+
+		//Splitting for 16 bit indices can regroup vertices, so it runs before they're compressed
+		mesh.indices = indices.data();
+		mesh.indexSize = sizeof(uint32_t);
+		if (packShortIndices(vertices, indices, pending->shortIndices))
+		{
+			mesh.indices = pending->shortIndices.data();
+			mesh.indexSize = sizeof(uint16_t);
+		}
+
+		mesh.vertices = vertices.data();
+		if constexpr (VERTEX_FORMAT == VertexFormat::Compact)
+		{
+			compressVertices(vertices, pending->compactVertices);
+			mesh.vertices = pending->compactVertices.data();
+		}
+		std::cout << "\tIndex size: " << mesh.indexSize * 8 << " bit, " << submeshes.size() << " submeshes" << std::endl;
+
+		mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+		mesh.indexCount = static_cast<uint32_t>(indices.size());
+		mesh.submeshes = submeshes.data();
+		mesh.submeshCount = static_cast<uint32_t>(submeshes.size());
+		mesh.boundsMin = boundsMin;
+		mesh.boundsMax = boundsMax;
+		mesh.boundingSphere = boundingSphere;
+		pending->cache->write(mesh);
+	}
+
+	void Model::upload()
 	{
-		loadOBJ(modelPath);
+		if (pending == nullptr)
+		{
+			throw std::runtime_error("failed to upload model, nothing was decoded!");
+		}
+
+		const MeshCache::MeshView& mesh = pending->mesh;
+		uploadVertices(mesh.vertices, mesh.vertexCount);
+		uploadIndices(mesh.indices, mesh.indexCount, mesh.indexSize);
+		buildDrawRanges();
+
+		//The staging ring has its own copy now, so the mapping or decoded arrays can go
+		pending.reset();
 	}
 
-	void Model::loadOBJ(const std::string& modelPath)
+	void Model::loadOBJ(const std::string& modelPath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
 	{
 		rapidobj::Result objResult = rapidobj::ParseFile(modelPath);
 		rapidobj::Triangulate(objResult);
 
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
+		const rapidobj::Attributes& attributes = objResult.attributes;
+		const size_t shapeCount = objResult.shapes.size();
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-		for (const auto& shape : objResult.shapes)
+		//Shapes are independent, so each one is assembled and deduplicated on its own, in parallel when there's a pool
+		auto forEachShape = [&](const std::function<void(uint32_t)>& task)
 		{
-			for (const auto& index : shape.mesh.indices)
+			if (threadPool != nullptr && shapeCount > 1)
+			{
+				threadPool->parallelFor(static_cast<uint32_t>(shapeCount), task);
+			}
+			else
 			{
-				Vertex vertex{};
-
-				vertex.position = {
-					objResult.attributes.positions[3 * index.position_index + 0],
-					objResult.attributes.positions[3 * index.position_index + 1],
-					objResult.attributes.positions[3 * index.position_index + 2]
-				};
-
-				vertex.normal = {
-					objResult.attributes.normals[3 * index.normal_index + 0],
-					objResult.attributes.normals[3 * index.normal_index + 1],
-					objResult.attributes.normals[3 * index.normal_index + 2]
-				};
-
-				vertex.texCoord = {
-					objResult.attributes.texcoords[2 * index.texcoord_index + 0],
-					objResult.attributes.texcoords[2 * index.texcoord_index + 1]
-				};
-
-				vertex.color = {
-					/*attrib.colors[3 * index.vertex_index + 0],
-					attrib.colors[3 * index.vertex_index + 1],
-					attrib.colors[3 * index.vertex_index + 2]*/
-					//attrib.normals[3 * index.normal_index + 0],
-					//attrib.normals[3 * index.normal_index + 1],
-					//attrib.normals[3 * index.normal_index + 2]
-					1, 1, 1
-				};
-
-				if (uniqueVertices.count(vertex) == 0)
+				for (uint32_t i = 0; i < shapeCount; i++)
 				{
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
+					task(i);
 				}
-
-				indices.push_back(uniqueVertices[vertex]);
 			}
+		};
+
+		std::vector<std::vector<Vertex>> shapeVertices(shapeCount);
+		std::vector<std::vector<uint32_t>> shapeIndices(shapeCount);
+		forEachShape([&](uint32_t shapeIndex)
+			{
+				const rapidobj::Array<rapidobj::Index>& shapeObjIndices = objResult.shapes[shapeIndex].mesh.indices;
+				std::vector<Vertex>& localVertices = shapeVertices[shapeIndex];
+				std::vector<uint32_t>& localIndices = shapeIndices[shapeIndex];
+				localIndices.resize(shapeObjIndices.size());
+				localVertices.reserve(shapeObjIndices.size());
+
+				//Identical index tuples always build identical vertices, so dedup works on the indices and only new vertices get built
+				VertexDedup uniqueVertices{ shapeObjIndices.size() };
+				for (size_t i = 0; i < shapeObjIndices.size(); i++)
+				{
+					const rapidobj::Index& index = shapeObjIndices[i];
+					bool isNew;
+					localIndices[i] = uniqueVertices.insert({ index.position_index, index.normal_index, index.texcoord_index }, isNew);
+					if (!isNew)
+					{
+						continue;
+					}
+
+					Vertex vertex{};
+
+					vertex.position = {
+						attributes.positions[3 * index.position_index + 0],
+						attributes.positions[3 * index.position_index + 1],
+						attributes.positions[3 * index.position_index + 2]
+					};
+
+					vertex.normal = {
+						attributes.normals[3 * index.normal_index + 0],
+						attributes.normals[3 * index.normal_index + 1],
+						attributes.normals[3 * index.normal_index + 2]
+					};
+
+					vertex.texCoord = {
+						attributes.texcoords[2 * index.texcoord_index + 0],
+						attributes.texcoords[2 * index.texcoord_index + 1]
+					};
+
+					vertex.color = {
+						/*attrib.colors[3 * index.vertex_index + 0],
+						attrib.colors[3 * index.vertex_index + 1],
+						attrib.colors[3 * index.vertex_index + 2]*/
+						//attrib.normals[3 * index.normal_index + 0],
+						//attrib.normals[3 * index.normal_index + 1],
+						//attrib.normals[3 * index.normal_index + 2]
+						1, 1, 1
+					};
+
+					localVertices.push_back(vertex);
+				}
+			});
+
+		//Offsets of each shape in the combined arrays, so the copies below can also run in parallel
+		std::vector<uint32_t> vertexOffsets(shapeCount);
+		uint32_t totalVertexCount = 0;
+		uint32_t totalIndexCount = 0;
+		for (size_t i = 0; i < shapeCount; i++)
+		{
+			vertexOffsets[i] = totalVertexCount;
+			submeshes.push_back({ totalIndexCount, static_cast<uint32_t>(shapeIndices[i].size()), 0 });
+			totalVertexCount += static_cast<uint32_t>(shapeVertices[i].size());
+			totalIndexCount += static_cast<uint32_t>(shapeIndices[i].size());
 		}
 
-		createVertexBuffer(vertices);
-		createIndexBuffer(indices);
+		vertices.resize(totalVertexCount);
+		indices.resize(totalIndexCount);
+		forEachShape([&](uint32_t shapeIndex)
+			{
+				std::copy(shapeVertices[shapeIndex].begin(), shapeVertices[shapeIndex].end(), vertices.begin() + vertexOffsets[shapeIndex]);
+
+				//Shape indices start from zero, rebase them onto the shape's place in the combined vertex array
+				uint32_t* output = indices.data() + submeshes[shapeIndex].firstIndex;
+				for (uint32_t index : shapeIndices[shapeIndex])
+				{
+					*output++ = index + vertexOffsets[shapeIndex];
+				}
+			});
 
 		std::cout << "OBJ File: " << modelPath << std::endl;
 		std::cout << "\tVertex count: " << vertices.size() << std::endl;
 		std::cout << "\tIndex count: " << indices.size() << std::endl;
 	}
 
-	void Model::createVertexBuffer(const std::vector<Vertex>& vertices)
+	void Model::optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
 	{
-		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be at least 3");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+		if (optimization == Optimization::None)
+		{
+			return;
+		}
+
+		MeshOptimizer::CacheStats before = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		//Triangles never move between submeshes, so each range is reordered on its own
+		for (const Submesh& submesh : submeshes)
+		{
+			uint32_t* submeshIndices = indices.data() + submesh.firstIndex;
+			MeshOptimizer::optimizeVertexCache(submeshIndices, submesh.indexCount, vertices.size());
+			if (optimization == Optimization::VertexCacheAndOverdraw)
+			{
+				MeshOptimizer::optimizeOverdraw(submeshIndices, submesh.indexCount, &vertices[0].position.x, sizeof(Vertex), vertices.size());
+			}
+		}
+		size_t usedVertexCount = MeshOptimizer::optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size());
+		vertices.resize(usedVertexCount);
+
+		MeshOptimizer::CacheStats after = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		std::cout << "\tACMR: " << before.acmr << " -> " << after.acmr << std::endl;
+		std::cout << "\tATVR: " << before.atvr << " -> " << after.atvr << std::endl;
+	}
 
-		AllocatedBuffer stagingBuffer;
-		device.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer);
+	bool Model::packShortIndices(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<uint16_t>& shortIndices)
+	{
+		constexpr uint32_t MAX_CHUNK_VERTICES = UINT16_MAX + 1;
+		constexpr uint32_t UNUSED = UINT32_MAX;
+
+		//Triangles are walked in order through every submesh and gather their vertices into chunks of at most 65536, each laid out
+		//contiguously and drawn with its first vertex as vertexOffset. Vertices shared across a chunk boundary are duplicated,
+		//which fetch ordered meshes keep to a thin seam
+		std::vector<Vertex> chunkedVertices;
+		chunkedVertices.reserve(vertices.size());
+		std::vector<uint32_t> chunkIndex(vertices.size(), UNUSED);
+		std::vector<uint32_t> chunkOf(vertices.size(), UNUSED);
+		std::vector<Submesh> splitSubmeshes;
+		shortIndices.resize(indices.size());
+
+		uint32_t chunk = 0;
+		uint32_t chunkStart = 0;
+		for (const Submesh& submesh : submeshes)
+		{
+			uint32_t end = submesh.firstIndex + submesh.indexCount;
+			uint32_t pieceStart = submesh.firstIndex;
+			for (uint32_t i = submesh.firstIndex; i < end; i += 3)
+			{
+				uint32_t newVertices = 0;
+				for (uint32_t corner = i; corner < i + 3; corner++)
+				{
+					newVertices += chunkOf[indices[corner]] != chunk;
+				}
 
-		void* data;
-		vmaMapMemory(device.getAllocator(), stagingBuffer.allocation, &data);
-		memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-		vmaUnmapMemory(device.getAllocator(), stagingBuffer.allocation);
+				if (chunkedVertices.size() - chunkStart + newVertices > MAX_CHUNK_VERTICES)
+				{
+					if (i > pieceStart)
+					{
+						splitSubmeshes.push_back({ pieceStart, i - pieceStart, static_cast<int32_t>(chunkStart) });
+					}
+					pieceStart = i;
+					chunk++;
+					chunkStart = static_cast<uint32_t>(chunkedVertices.size());
+				}
 
-		device.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, vertexBuffer);
+				for (uint32_t corner = i; corner < i + 3; corner++)
+				{
+					uint32_t vertex = indices[corner];
+					if (chunkOf[vertex] != chunk)
+					{
+						chunkOf[vertex] = chunk;
+						chunkIndex[vertex] = static_cast<uint32_t>(chunkedVertices.size()) - chunkStart;
+						chunkedVertices.push_back(vertices[vertex]);
+					}
+					shortIndices[corner] = static_cast<uint16_t>(chunkIndex[vertex]);
+				}
+			}
 
-		VkUtil::copyBuffer(device, stagingBuffer.buffer, vertexBuffer.buffer, bufferSize);
+			if (end > pieceStart)
+			{
+				splitSubmeshes.push_back({ pieceStart, end - pieceStart, static_cast<int32_t>(chunkStart) });
+			}
+		}
 
-		vmaDestroyBuffer(device.getAllocator(), stagingBuffer.buffer, stagingBuffer.allocation);
+		//Only worth it while the duplicated vertices cost less than the index bytes saved
+		size_t duplicatedVertices = chunkedVertices.size() > vertices.size() ? chunkedVertices.size() - vertices.size() : 0;
+		if (duplicatedVertices * VERTEX_STRIDE >= indices.size() * (sizeof(uint32_t) - sizeof(uint16_t)))
+		{
+			shortIndices.clear();
+			return false;
+		}
+
+		vertices = std::move(chunkedVertices);
+		submeshes = std::move(splitSubmeshes);
+		return true;
 	}
 
-	void Model::createIndexBuffer(const std::vector<uint32_t>& indices)
+	void Model::buildDrawRanges()
 	{
-		indexCount = static_cast<uint32_t>(indices.size());
-		assert(indexCount >= 3 && "Vertex count must be at least 3");
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
+		//Neighbouring submeshes with the same vertexOffset draw as one
+		drawRanges.clear();
+		for (const Submesh& submesh : submeshes)
+		{
+			if (!drawRanges.empty() && drawRanges.back().vertexOffset == submesh.vertexOffset
+				&& drawRanges.back().firstIndex + drawRanges.back().indexCount == submesh.firstIndex)
+			{
+				drawRanges.back().indexCount += submesh.indexCount;
+			}
+			else
+			{
+				drawRanges.push_back(submesh);
+			}
+		}
 
-		AllocatedBuffer stagingBuffer;
-		device.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer);
+		//Submeshes are relative to the mesh, draws to the arena
+		for (Submesh& range : drawRanges)
+		{
+			range.firstIndex += firstIndex;
+			range.vertexOffset += static_cast<int32_t>(vertexOffset);
+		}
+	}
 
-		void* data;
-		vmaMapMemory(device.getAllocator(), stagingBuffer.allocation, &data);
-		memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-		vmaUnmapMemory(device.getAllocator(), stagingBuffer.allocation);
+	void Model::calculateBounds(const std::vector<Vertex>& vertices)
+	{
+		//An OBJ without faces is valid, it gets empty bounds at the origin
+		if (vertices.empty())
+		{
+			boundsMin = glm::vec3{ 0.0f };
+			boundsMax = glm::vec3{ 0.0f };
+			boundingSphere = glm::vec4{ 0.0f };
+			return;
+		}
 
-		device.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, indexBuffer);
+		boundsMin = vertices[0].position;
+		boundsMax = vertices[0].position;
+		for (const Vertex& vertex : vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
 
-		VkUtil::copyBuffer(device, stagingBuffer.buffer, indexBuffer.buffer, bufferSize);
+		//Centered on the box rather than a minimal sphere, which is close enough for culling
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		float radiusSquared = 0.0f;
+		for (const Vertex& vertex : vertices)
+		{
+			glm::vec3 offset = vertex.position - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
 
-		vmaDestroyBuffer(device.getAllocator(), stagingBuffer.buffer, stagingBuffer.allocation);
+		boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+	}
+
+	void Model::compressVertices(const std::vector<Vertex>& vertices, std::vector<CompactVertex>& compactVertices) const
+	{
+		//Flat axes get a zero extent, which quantizes everything on them to zero
+		glm::vec3 extent = boundsMax - boundsMin;
+		glm::vec3 inverseExtent{ extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f };
+
+		compactVertices.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& vertex = vertices[i];
+			CompactVertex& compactVertex = compactVertices[i];
+
+			glm::vec3 position = glm::clamp((vertex.position - boundsMin) * inverseExtent, 0.0f, 1.0f);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				compactVertex.position[axis] = static_cast<uint16_t>(std::round(position[axis] * 65535.0f));
+			}
+			compactVertex.position[3] = 0;
+
+			//Project onto the octahedron, then fold the lower half out over the corners
+			glm::vec3 normal = vertex.normal;
+			float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+			glm::vec2 octahedral = length > 0.0f ? glm::vec2(normal.x, normal.y) / length : glm::vec2(0.0f);
+			if (normal.z < 0.0f)
+			{
+				octahedral = glm::vec2(
+					(1.0f - std::abs(octahedral.y)) * (octahedral.x >= 0.0f ? 1.0f : -1.0f),
+					(1.0f - std::abs(octahedral.x)) * (octahedral.y >= 0.0f ? 1.0f : -1.0f));
+			}
+			compactVertex.normal[0] = static_cast<int16_t>(std::round(glm::clamp(octahedral.x, -1.0f, 1.0f) * 32767.0f));
+			compactVertex.normal[1] = static_cast<int16_t>(std::round(glm::clamp(octahedral.y, -1.0f, 1.0f) * 32767.0f));
+
+			compactVertex.texCoord = glm::packHalf2x16(vertex.texCoord);
+		}
+	}
+
+	void Model::uploadVertices(const void* vertices, uint32_t count)
+	{
+		vertexCount = count;
+		assert(vertexCount >= 3 && "Vertex count must be at least 3");
+
+		//Full vertices are already in object space, so their decode is the identity
+		VertexDecode decode{ glm::vec4(0.0f), glm::vec4(1.0f) };
+		if constexpr (VERTEX_FORMAT == VertexFormat::Compact)
+		{
+			decode = { glm::vec4(boundsMin, 0.0f), glm::vec4(boundsMax - boundsMin, 0.0f) };
+		}
+
+		//The decode takes the slots of a vertex or two right after the mesh, so one arena allocation holds both
+		constexpr uint32_t decodeSlots = (sizeof(VertexDecode) + VERTEX_STRIDE - 1) / VERTEX_STRIDE;
+		vertexOffset = geometryArena.allocateVertices(vertexCount + decodeSlots);
+		decodeOffset = static_cast<VkDeviceSize>(vertexOffset + vertexCount) * VERTEX_STRIDE;
+		VkDeviceSize verticesSize = static_cast<VkDeviceSize>(VERTEX_STRIDE) * vertexCount;
+
+		UploadBatcher& uploadBatcher = device.getUploadBatcher();
+		uploadBatcher.uploadBuffer(geometryArena.getVertexBuffer(), static_cast<VkDeviceSize>(vertexOffset) * VERTEX_STRIDE, vertices, verticesSize);
+		uploadBatcher.uploadBuffer(geometryArena.getVertexBuffer(), decodeOffset, &decode, sizeof(VertexDecode));
+	}
+
+	void Model::uploadIndices(const void* indices, uint32_t count, uint32_t indexSize)
+	{
+		indexCount = count;
+		indexType = indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		assert(indexCount >= 3 && "Vertex count must be at least 3");
+		VkDeviceSize bufferSize = static_cast<VkDeviceSize>(indexSize) * indexCount;
+
+		VkDeviceSize indexOffset = geometryArena.allocateIndices(bufferSize);
+		firstIndex = static_cast<uint32_t>(indexOffset / indexSize);
+
+		device.getUploadBatcher().uploadBuffer(geometryArena.getIndexBuffer(), indexOffset, indices, bufferSize);
+		//The indices are uploaded last, so their batch covers the vertices too
+		uploadValue = device.getUploadBatcher().getUploadValue();
+	}
+
+	bool Model::isReady()
+	{
+		return device.getUploadBatcher().isComplete(uploadValue);
 	}
 
 	void Model::bind(VkCommandBuffer commandBuffer)
 	{
-		VkBuffer buffers[] = { vertexBuffer.buffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+		geometryArena.bind(commandBuffer, indexType);
+		bindDecode(commandBuffer);
+	}
+
+	void Model::bindDecode(VkCommandBuffer commandBuffer)
+	{
+		VkBuffer buffer = geometryArena.getVertexBuffer();
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &buffer, &decodeOffset);
 	}
 
-	void Model::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance)
+	void Model::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t instanceCount)
 	{
 		//vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, firstInstance);
+		for (const Submesh& range : drawRanges)
+		{
+			vkCmdDrawIndexed(commandBuffer, range.indexCount, instanceCount, range.firstIndex, range.vertexOffset, firstInstance);
+		}
 	}
 
 	std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions()
 	{
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
 
 		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
+		bindingDescriptions[0].stride = VERTEX_STRIDE;
 		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
+		//Zero stride per instance reads the same VertexDecode for every instance, whatever firstInstance is
+		bindingDescriptions[1].binding = 1;
+		bindingDescriptions[1].stride = 0;
+		bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
 		return bindingDescriptions;
 	}
 
 	std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions()
 	{
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, position);
+		if constexpr (VERTEX_FORMAT == VertexFormat::Compact)
+		{
+			attributeDescriptions.resize(5);
+
+			attributeDescriptions[0].binding = 0;
+			attributeDescriptions[0].location = 0;
+			attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+			attributeDescriptions[0].offset = offsetof(CompactVertex, position);
+
+			attributeDescriptions[1].binding = 0;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+			attributeDescriptions[1].offset = offsetof(CompactVertex, normal);
+
+			attributeDescriptions[2].binding = 0;
+			attributeDescriptions[2].location = 2;
+			attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+			attributeDescriptions[2].offset = offsetof(CompactVertex, texCoord);
+		}
+		else
+		{
+			attributeDescriptions.resize(6);
+
+			attributeDescriptions[0].binding = 0;
+			attributeDescriptions[0].location = 0;
+			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[0].offset = offsetof(Vertex, position);
+
+			attributeDescriptions[1].binding = 0;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[1].offset = offsetof(Vertex, normal);
+
+			attributeDescriptions[2].binding = 0;
+			attributeDescriptions[2].location = 2;
+			attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+			attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+			attributeDescriptions[3].binding = 0;
+			attributeDescriptions[3].location = 3;
+			attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[3].offset = offsetof(Vertex, color);
+		}
 
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, normal);
+		VkVertexInputAttributeDescription* decodeDescriptions = &attributeDescriptions[attributeDescriptions.size() - 2];
 
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+		decodeDescriptions[0].binding = 1;
+		decodeDescriptions[0].location = 4;
+		decodeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		decodeDescriptions[0].offset = offsetof(VertexDecode, positionOffset);
 
-		attributeDescriptions[3].binding = 0;
-		attributeDescriptions[3].location = 3;
-		attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[3].offset = offsetof(Vertex, color);
+		decodeDescriptions[1].binding = 1;
+		decodeDescriptions[1].location = 5;
+		decodeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		decodeDescriptions[1].offset = offsetof(VertexDecode, positionScale);
 
 		return attributeDescriptions;
 	}
 
 	Model::~Model()
 	{
-		vmaDestroyBuffer(device.getAllocator(), vertexBuffer.buffer, vertexBuffer.allocation);
-		vmaDestroyBuffer(device.getAllocator(), indexBuffer.buffer, indexBuffer.allocation);
+		//Never uploaded, so nothing in the arena is ours
+		if (uploadValue == NOT_UPLOADED)
+		{
+			return;
+		}
+		//Frames still in flight may be drawing the mesh, so the arena holds the ranges back until they have finished
+		geometryArena.free(vertexOffset, static_cast<VkDeviceSize>(firstIndex) * (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)), uploadValue);
 	}
 }
\ No newline at end of file
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "device.hpp"
+#include "geometry_arena.hpp"
+#include "mesh_cache.hpp"
+#include "thread_pool.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
 
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <iostream>
 
@@ -24,52 +28,138 @@ namespace rub
 			glm::vec2 texCoord;
 			glm::vec3 color;
 
+			//Descriptions for VERTEX_FORMAT, including the VertexDecode binding
 			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 
+			//Matches what VertexDedup treats as the same vertex, vertices that only differ in normal stay separate
 			bool operator==(const Vertex& other) const
 			{
-				return position == other.position && color == other.color && texCoord == other.texCoord;
+				return position == other.position && normal == other.normal && texCoord == other.texCoord && color == other.color;
 			}
 		};
 
-		Model(Device& rubDevice, const std::string modelPath);
+		enum class VertexFormat
+		{
+			//Vertex as loaded, 44 bytes
+			Full,
+			//CompactVertex, 16 bytes
+			Compact
+		};
+
+		//Layout of every vertex buffer and of the vertex input of every pipeline
+		static constexpr VertexFormat VERTEX_FORMAT = VertexFormat::Compact;
+
+		//Positions are unorm16 relative to the mesh bounds, normals are octahedral snorm16 and texture coordinates are half floats.
+		//Shaders rebuild positions from the VertexDecode bound alongside, and normals when the COMPACT_VERTICES constant is set
+		struct CompactVertex
+		{
+			uint16_t position[4];
+			int16_t normal[2];
+			uint32_t texCoord;
+		};
+
+		static constexpr uint32_t VERTEX_STRIDE = VERTEX_FORMAT == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+
+		//Per mesh constants read through a second, zero stride vertex binding, so every draw path gets them without push constants
+		struct VertexDecode
+		{
+			glm::vec4 positionOffset;
+			glm::vec4 positionScale;
+		};
+
+		//Reordering applied after deduplication. Any level also reorders vertices into fetch order
+		enum class Optimization : uint32_t
+		{
+			None,
+			VertexCache,
+			VertexCacheAndOverdraw
+		};
+
+		//Shapes in the source file are assembled on threadPool when one is given. The mesh lives in geometryArena until the model is destroyed
+		Model(Device& rubDevice, GeometryArena& geometryArena, const std::string modelPath, ThreadPool* threadPool = nullptr,
+			Optimization optimization = Optimization::VertexCache);
+		//Empty until decode() and upload() are called, for loading in the background. Shapes are assembled serially, since the
+		//decode is usually already running on a worker
+		Model(Device& rubDevice, GeometryArena& geometryArena, Optimization optimization = Optimization::VertexCache);
 		~Model();
 
+		//Reads the mesh from its cache or source file into memory. Touches nothing on the GPU, so it can run on any thread
+		void decode(const std::string& modelPath);
+		//Copies the decoded mesh into the arena through the upload batcher, on the thread that owns it
+		void upload();
+
+		//Binds the arena with this model's index type and its VertexDecode
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance);
+		//Only the VertexDecode, for when the arena is already bound with the right index type
+		void bindDecode(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t instanceCount = 1);
+		uint32_t getId() const { return id; }
+		uint32_t getIndexCount() const { return indexCount; }
+		VkIndexType getIndexType() const { return indexType; }
+		GeometryArena& getGeometryArena() const { return geometryArena; }
+		//Object space bounds, computed once at load
+		glm::vec3 getBoundsMin() const { return boundsMin; }
+		glm::vec3 getBoundsMax() const { return boundsMax; }
+		//Object space center in xyz, radius in w
+		glm::vec4 getBoundingSphere() const { return boundingSphere; }
+		//One index range per shape in the source file, more when 16 bit indices split a shape
+		const std::vector<Submesh>& getSubmeshes() const { return submeshes; }
+		//Submeshes merged into as few draws as the index type allows, usually one. Already offset to this model's place in the arena
+		const std::vector<Submesh>& getDrawRanges() const { return drawRanges; }
+		//True once the mesh is decoded, uploaded, and the graphics queue owns it
+		bool isReady();
 
 	private:
+		//CPU side of a decoded mesh, kept from decode() until upload() has staged it
+		struct PendingMesh
+		{
+			//Holds the mapping open when the mesh came from the cache
+			std::unique_ptr<MeshCache> cache;
+			std::vector<Vertex> vertices;
+			std::vector<CompactVertex> compactVertices;
+			std::vector<uint32_t> indices;
+			std::vector<uint16_t> shortIndices;
+			MeshCache::MeshView mesh{};
+		};
+
+		static constexpr uint64_t NOT_UPLOADED = UINT64_MAX;
+
 		Device& device;
+		GeometryArena& geometryArena;
+		const uint32_t id;
+		ThreadPool* threadPool;
+		Optimization optimization;
 
-		AllocatedBuffer vertexBuffer;
+		static std::atomic<uint32_t> nextId;
+
+		uint32_t vertexOffset;
 		uint32_t vertexCount;
+		VkDeviceSize decodeOffset;
 
-		AllocatedBuffer indexBuffer;
+		uint32_t firstIndex;
 		uint32_t indexCount;
+		VkIndexType indexType;
+		uint64_t uploadValue = NOT_UPLOADED;
 
-		void loadOBJ(const std::string& modelPath);
-		void createVertexBuffer(const std::vector<Vertex>& vertices);
-		void createIndexBuffer(const std::vector<uint32_t>& indices);
-	};
-}
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		glm::vec4 boundingSphere{ 0.0f };
+		std::vector<Submesh> submeshes;
+		std::vector<Submesh> drawRanges;
 
-namespace std
-{
-	template<> struct hash<rub::Model::Vertex>
-	{
-		size_t operator()(rub::Model::Vertex const& vertex) const
-		{
-			//return 1;
-			return ((hash<glm::vec3>()(vertex.position) ^
-				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.texCoord) << 1);
-			//return (
-			//	hash<glm::vec3>()(vertex.position) ^ 
-			//	hash<glm::vec3>()(vertex.normal) ^
-			//	hash<glm::vec2>()(vertex.texCoord) ^
-			//	hash<glm::vec3>()(vertex.color)
-			//);
-		}
+		std::unique_ptr<PendingMesh> pending;
+
+		void loadOBJ(const std::string& modelPath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+		void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+		//Rewrites indices as 16 bit, splitting submeshes so no draw reaches more than 65536 vertices. Vertices are regrouped per split and
+		//submeshes replaced only when that pays off
+		bool packShortIndices(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<uint16_t>& shortIndices);
+		void buildDrawRanges();
+		void calculateBounds(const std::vector<Vertex>& vertices);
+		void compressVertices(const std::vector<Vertex>& vertices, std::vector<CompactVertex>& compactVertices) const;
+		//Vertices in VERTEX_FORMAT, followed by this mesh's VertexDecode
+		void uploadVertices(const void* vertices, uint32_t count);
+		void uploadIndices(const void* indices, uint32_t count, uint32_t indexSize);
 	};
 }
\ No newline at end of file
@@ -5,12 +5,14 @@
 
 namespace rub
 {
-	Pipeline::Pipeline(Device& device, const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo) : device{ device }
+	std::atomic<uint32_t> Pipeline::nextId{ 0 };
+
+	Pipeline::Pipeline(Device& device, const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo) : device{ device }, id{ nextId++ }
 	{
 		createGraphicsPipeline(vertPath, fragPath, configInfo);
 	}
 
-	Pipeline::Pipeline(Device& device, const std::string& compPath, const VkPipelineLayout pipelineLayout) : device{ device }, isCompute{ true }
+	Pipeline::Pipeline(Device& device, const std::string& compPath, const VkPipelineLayout pipelineLayout) : device{ device }, isCompute{ true }, id{ nextId++ }
 	{
 		createComputePipeline(compPath, pipelineLayout);
 	}
@@ -41,6 +43,16 @@ namespace rub
 		createShaderModule(vertShaderCode, &vertShaderModule);
 		createShaderModule(fragShaderCode, &fragShaderModule);
 
+		//Vertex shaders decode either vertex format, COMPACT_VERTICES (constant_id 0) picks which.
+		//Shaders that don't declare a constant ignore its entry
+		VkBool32 vertexConstants[2] = { Model::VERTEX_FORMAT == Model::VertexFormat::Compact, configInfo.modelMatrixOnly };
+		VkSpecializationMapEntry vertexSpecializationEntries[2] = { { 0, 0, sizeof(VkBool32) }, { 1, sizeof(VkBool32), sizeof(VkBool32) } };
+		VkSpecializationInfo vertexSpecializationInfo{};
+		vertexSpecializationInfo.mapEntryCount = 2;
+		vertexSpecializationInfo.pMapEntries = vertexSpecializationEntries;
+		vertexSpecializationInfo.dataSize = sizeof(vertexConstants);
+		vertexSpecializationInfo.pData = vertexConstants;
+
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -48,7 +60,7 @@ namespace rub
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = &vertexSpecializationInfo;
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		shaderStages[1].module = fragShaderModule;
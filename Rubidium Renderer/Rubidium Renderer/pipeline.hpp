@@ -2,6 +2,7 @@
 
 #include "device.hpp"
 
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -23,6 +24,9 @@ namespace rub
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+
+		//Sets MODEL_MATRIX_ONLY (constant_id 1) for vertex shaders that read the object buffer
+		VkBool32 modelMatrixOnly = VK_FALSE;
 	};
 
 	class Pipeline
@@ -33,6 +37,7 @@ namespace rub
 		~Pipeline();
 
 		void bind(VkCommandBuffer commandBuffer);
+		uint32_t getId() const { return id; }
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
@@ -43,6 +48,9 @@ namespace rub
 		VkShaderModule fragShaderModule;
 		VkShaderModule compShaderModule;
 		const bool isCompute = false;
+		const uint32_t id;
+
+		static std::atomic<uint32_t> nextId;
 
 		static std::vector<char> readFile(const std::string& filePath);
 
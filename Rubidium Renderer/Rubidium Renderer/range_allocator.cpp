@@ -0,0 +1,95 @@
+#include "range_allocator.hpp"
+
+#include <stdexcept>
+
+namespace rub
+{
+	RangeAllocator::RangeAllocator(uint64_t capacity) : capacity{ capacity }, freeSize{ 0 }
+	{
+		if (capacity > 0)
+		{
+			insertFree(0, capacity);
+		}
+	}
+
+	uint64_t RangeAllocator::allocate(uint64_t size)
+	{
+		if (size == 0)
+		{
+			return INVALID;
+		}
+
+		auto bestFit = freeBySize.lower_bound(size);
+		if (bestFit == freeBySize.end())
+		{
+			return INVALID;
+		}
+
+		uint64_t offset = bestFit->second;
+		uint64_t rangeSize = bestFit->first;
+		eraseFree(freeByOffset.find(offset));
+		if (rangeSize > size)
+		{
+			insertFree(offset + size, rangeSize - size);
+		}
+
+		allocations[offset] = size;
+		return offset;
+	}
+
+	void RangeAllocator::free(uint64_t offset)
+	{
+		auto allocation = allocations.find(offset);
+		if (allocation == allocations.end())
+		{
+			throw std::runtime_error("failed to free range, offset was not allocated!");
+		}
+		uint64_t size = allocation->second;
+		allocations.erase(allocation);
+
+		//Merge with the free ranges directly before and after, so the free list never holds two touching ranges
+		auto next = freeByOffset.lower_bound(offset);
+		if (next != freeByOffset.end() && offset + size == next->first)
+		{
+			size += next->second;
+			eraseFree(next);
+		}
+
+		auto previous = freeByOffset.lower_bound(offset);
+		if (previous != freeByOffset.begin())
+		{
+			previous--;
+			if (previous->first + previous->second == offset)
+			{
+				offset = previous->first;
+				size += previous->second;
+				eraseFree(previous);
+			}
+		}
+
+		insertFree(offset, size);
+	}
+
+	void RangeAllocator::insertFree(uint64_t offset, uint64_t size)
+	{
+		freeByOffset[offset] = size;
+		freeBySize.emplace(size, offset);
+		freeSize += size;
+	}
+
+	void RangeAllocator::eraseFree(std::map<uint64_t, uint64_t>::iterator range)
+	{
+		auto sized = freeBySize.equal_range(range->second);
+		for (auto it = sized.first; it != sized.second; it++)
+		{
+			if (it->second == range->first)
+			{
+				freeBySize.erase(it);
+				break;
+			}
+		}
+
+		freeSize -= range->second;
+		freeByOffset.erase(range);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+namespace rub
+{
+	//Hands out ranges of [0, capacity) in arbitrary units. Free ranges are kept both by offset, to merge neighbours when a range is
+	//returned, and by size, so allocation is a best fit lookup instead of a walk over the free list
+	class RangeAllocator
+	{
+	public:
+		static constexpr uint64_t INVALID = std::numeric_limits<uint64_t>::max();
+
+		explicit RangeAllocator(uint64_t capacity);
+
+		//Returns the offset of the range, or INVALID when no free range is large enough
+		uint64_t allocate(uint64_t size);
+		void free(uint64_t offset);
+
+		uint64_t getCapacity() const { return capacity; }
+		uint64_t getFreeSize() const { return freeSize; }
+
+	private:
+		uint64_t capacity;
+		uint64_t freeSize;
+		std::map<uint64_t, uint64_t> freeByOffset;
+		std::multimap<uint64_t, uint64_t> freeBySize;
+		std::unordered_map<uint64_t, uint64_t> allocations;
+
+		void insertFree(uint64_t offset, uint64_t size);
+		void eraseFree(std::map<uint64_t, uint64_t>::iterator range);
+	};
+}
\ No newline at end of file
@@ -17,5 +17,7 @@ namespace rub
 		std::shared_ptr<Model> model{};
 		std::shared_ptr<Material> material;
 		Transform transform;
+		//Index of an earlier object in the same list that this one's transform is relative to, -1 for none
+		int parent = -1;
 	};
 }
\ No newline at end of file
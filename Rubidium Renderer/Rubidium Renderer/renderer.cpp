@@ -8,35 +8,87 @@
 
 #include <stdexcept>
 #include <array>
+#include <limits>
+#include <algorithm>
 
 namespace rub
 {
 	Renderer::Renderer(Window& window, Device& device) : window{ window }, device{ device }
 	{
 		recreateSwapChain();
-		createCommandBuffers();
+		createFrameContexts();
 	}
 
-	void Renderer::createCommandBuffers()
+	void Renderer::createFrameContexts()
 	{
-		commandBuffers.resize(swapChain->imageCount());
+		QueueFamilyIndices queueFamilyIndices = device.findPhysicalQueueFamilies();
 
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = device.getCommandPool();
-		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		//timestampComputeAndGraphics alone doesn't promise the graphics family writes them, its valid bits do
+		uint32_t validBits = queueFamilyIndices.graphicsTimestampValidBits;
+		if (device.getDeviceProperties().limits.timestampComputeAndGraphics && validBits > 0)
+		{
+			timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (1ull << validBits) - 1;
+		}
 
-		if (vkAllocateCommandBuffers(device.getDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		for (FrameContext& frame : frames)
 		{
-			throw std::runtime_error("failed to allocate command buffers!");
+			//Transient pool that is reset as a whole at the start of the frame instead of per command buffer
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create frame command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = frame.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate command buffers!");
+			}
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+			if (vkCreateFence(device.getDevice(), &fenceInfo, nullptr, &frame.inFlightFence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create synchronization objects for a frame!");
+			}
+
+			if (timestampMask != 0)
+			{
+				VkQueryPoolCreateInfo queryPoolInfo{};
+				queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryPoolInfo.queryCount = 2;
+
+				if (vkCreateQueryPool(device.getDevice(), &queryPoolInfo, nullptr, &frame.timestampPool) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create frame timestamp query pool!");
+				}
+			}
 		}
 	}
 
-	void Renderer::freeCommandBuffers()
+	void Renderer::destroyFrameContexts()
 	{
-		vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), static_cast<float>(commandBuffers.size()), commandBuffers.data());
-		commandBuffers.clear();
+		for (FrameContext& frame : frames)
+		{
+			vkDestroyCommandPool(device.getDevice(), frame.commandPool, nullptr);
+			vkDestroyFence(device.getDevice(), frame.inFlightFence, nullptr);
+			if (frame.timestampPool != VK_NULL_HANDLE)
+			{
+				vkDestroyQueryPool(device.getDevice(), frame.timestampPool, nullptr);
+			}
+		}
 	}
 
 	void Renderer::recreateSwapChain()
@@ -57,11 +109,6 @@ namespace rub
 		else
 		{
 			swapChain = std::make_unique<SwapChain>(device, extent, std::move(swapChain));
-			if (swapChain->imageCount() != commandBuffers.size())
-			{
-				freeCommandBuffers();
-				createCommandBuffers();
-			}
 		}
 	}
 
@@ -69,6 +116,11 @@ namespace rub
 	{
 		assert(!isFrameStarted && "can't call beginFrame while frame is in progress");
 
+		FrameContext& frame = frames[currentFrameIndex];
+		vkWaitForFences(device.getDevice(), 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		completedFrameCount = std::max(completedFrameCount, frame.submittedFrameCount);
+		readTimestamps(frame);
+
 		auto result = swapChain->acquireNextImage(&currentImageIndex);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -84,29 +136,65 @@ namespace rub
 
 		isFrameStarted = true;
 
+		//The fence guarantees the GPU is done with everything this frame recorded last time around
+		vkResetCommandPool(device.getDevice(), frame.commandPool, 0);
+
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
 
+		if (frame.timestampPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(commandBuffer, frame.timestampPool, 0, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampPool, 0);
+		}
+
 		return commandBuffer;
 	}
 
+	void Renderer::readTimestamps(FrameContext& frame)
+	{
+		if (!frame.timestampsWritten)
+		{
+			return;
+		}
+
+		//The fence has already been waited on, so the results are available without stalling
+		std::array<uint64_t, 2> timestamps;
+		if (vkGetQueryPoolResults(device.getDevice(), frame.timestampPool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), 
+			VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			//Bits above the valid ones are undefined, masking the difference also handles the counter wrapping between the writes
+			uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+			gpuTime = ticks * device.getDeviceProperties().limits.timestampPeriod / 1000000.0;
+		}
+		frame.timestampsWritten = false;
+	}
+
 	void Renderer::endFrame()
 	{
 		assert(isFrameStarted && "can't call endFrame while frame isn't in progress");
 
+		FrameContext& frame = frames[currentFrameIndex];
 		auto commandBuffer = getCurrentCommandBuffer();
+		if (frame.timestampPool != VK_NULL_HANDLE)
+		{
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, 1);
+			frame.timestampsWritten = true;
+		}
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to record command buffer!");
 		}
 
-		auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, frame.inFlightFence);
+		frame.submittedFrameCount = ++frameCount;
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized())
 		{
 			window.resetWindowResizedFlag();
@@ -118,9 +206,10 @@ namespace rub
 		}
 
 		isFrameStarted = false;
+		currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void Renderer::beginRenderPass(VkCommandBuffer commandBuffer)
+	void Renderer::beginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(isFrameStarted && "can't call beginRenderPass if frame isn't in progress");
 		assert(commandBuffer == getCurrentCommandBuffer() && "can't end render pass on command buffer from a different frame");
@@ -139,18 +228,16 @@ namespace rub
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = static_cast<float>(swapChain->getSwapChainExtent().height);
-		viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-		viewport.height = -static_cast<float>(swapChain->getSwapChainExtent().height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{ {0, 0}, swapChain->getSwapChainExtent() };
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+		//Secondary command buffers set their own dynamic state
+		if (contents == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			VkViewport viewport = swapChain->getViewport();
+			VkRect2D scissor = swapChain->getScissor();
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		}
 	}
 
 	void Renderer::endRenderPass(VkCommandBuffer commandBuffer)
@@ -163,6 +250,6 @@ namespace rub
 
 	Renderer::~Renderer()
 	{
-		freeCommandBuffers();
+		destroyFrameContexts();
 	}
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <vector>
+#include <array>
 #include <cassert>
 
 namespace rub
@@ -14,6 +15,20 @@ namespace rub
 	class Renderer
 	{
 	public:
+		//Everything a single frame in flight records into or writes to. Reused once the frame's fence has signaled.
+		struct FrameContext
+		{
+			VkCommandPool commandPool;
+			VkCommandBuffer commandBuffer;
+			VkFence inFlightFence;
+			//Frame count once this frame's last submit went out, so the fence signaling means that many frames have completed
+			uint64_t submittedFrameCount = 0;
+
+			//Timestamps at the start and end of the frame's command buffer, read back the next time the frame comes around
+			VkQueryPool timestampPool = VK_NULL_HANDLE;
+			bool timestampsWritten = false;
+		};
+
 		Renderer(Window& window, Device& device);
 		~Renderer();
 
@@ -22,12 +37,18 @@ namespace rub
 		VkCommandBuffer getCurrentCommandBuffer()
 		{
 			assert(isFrameStarted && "can't get command buffer when frame isn't started");
-			return commandBuffers[currentImageIndex];
+			return frames[currentFrameIndex].commandBuffer;
 		}
+		int getFrameIndex() const { return currentFrameIndex; }
+		//Frames submitted so far, and how many of them the GPU has finished as of the last beginFrame
+		uint64_t getFrameCount() const { return frameCount; }
+		uint64_t getCompletedFrameCount() const { return completedFrameCount; }
+		//GPU time of the most recent frame that has finished, in milliseconds. Zero if the queue can't write timestamps
+		double getGpuTime() const { return gpuTime; }
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginRenderPass(VkCommandBuffer commandBuffer);
+		void beginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endRenderPass(VkCommandBuffer commandBuffer);
 		std::unique_ptr<SwapChain>& getSwapChain() { return swapChain; };
 
@@ -36,12 +57,19 @@ namespace rub
 		Device& device;
 
 		std::unique_ptr<SwapChain> swapChain;
-		std::vector<VkCommandBuffer> commandBuffers;
+		std::array<FrameContext, SwapChain::MAX_FRAMES_IN_FLIGHT> frames;
 		bool isFrameStarted = false;
 		uint32_t currentImageIndex;
+		int currentFrameIndex = 0;
+		uint64_t frameCount = 0;
+		uint64_t completedFrameCount = 0;
+		double gpuTime = 0;
+		//Valid bits of the graphics family's timestamps, 0 when frames aren't timed
+		uint64_t timestampMask = 0;
 
-		void createCommandBuffers();
-		void freeCommandBuffers();
+		void createFrameContexts();
+		void destroyFrameContexts();
 		void recreateSwapChain();
+		void readTimestamps(FrameContext& frame);
 	};
 }
\ No newline at end of file
@@ -2,17 +2,110 @@
 
 #include "vk_util.hpp"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+
 namespace rub
 {
-	Scene::Scene(Device& device, std::unique_ptr<SwapChain>& swapChain, std::shared_ptr<Camera> camera, const std::string& environmentPath, std::vector<RenderObject>& renderObjects)
-		: device{ device }, renderObjects{ renderObjects }, FRAMEBUFFER_COUNT{ swapChain->MAX_FRAMES_IN_FLIGHT }, camera{ camera }
+	Scene::Scene(Device& device, std::unique_ptr<SwapChain>& swapChain, ThreadPool& threadPool, GeometryArena& geometryArena, std::shared_ptr<Camera> camera, const std::string& environmentPath, 
+		std::vector<RenderObject>& renderObjects, DrawPath drawPath)
+		: device{ device }, swapChain{ swapChain }, threadPool{ threadPool }, FRAMEBUFFER_COUNT{ swapChain->MAX_FRAMES_IN_FLIGHT }, camera{ camera },
+		objects{ registry.group<TransformNode, WorldMatrix, LocalBounds, MeshHandle, MaterialHandle>() }, drawPath{ drawPath }
 	{
-		globalCubemap = std::make_unique<Cubemap>(device);
-		skybox = std::make_unique<Skybox>(device, "textures/spruit_sunrise_2k.exr");
+		createObjects(renderObjects);
+		globalCubemap = std::make_unique<Cubemap>(device, geometryArena);
+		skybox = std::make_unique<Skybox>(device, geometryArena, "textures/spruit_sunrise_2k.exr", &threadPool);
 
 		createBRDF();
 		createDescriptorSetLayout();
 		createFramebuffers();
+		createRecordingContexts();
+	}
+
+	void Scene::createObjects(std::vector<RenderObject>& renderObjects)
+	{
+		//The group exists before any components do, so entities are packed into it as they are added, in creation order
+		for (size_t i = 0; i < renderObjects.size(); i++)
+		{
+			RenderObject& object = renderObjects[i];
+			if (object.parent >= static_cast<int>(i))
+			{
+				throw std::runtime_error("failed to create object, parents must come before their children!");
+			}
+
+			const TransformNode* nodes = objects.raw<TransformNode>();
+			uint32_t parentNode = object.parent < 0 ? TransformHierarchy::NO_PARENT : nodes[object.parent].node;
+			uint32_t node = transforms.addNode(parentNode, object.transform.position, object.transform.getOrientation());
+			nodeObjects.resize(transforms.size());
+			nodeObjects[node] = static_cast<uint32_t>(i);
+
+			entt::entity entity = registry.create();
+			registry.emplace<TransformNode>(entity, node);
+			registry.emplace<WorldMatrix>(entity, glm::mat4{ 1.0f });
+			//A model still loading has no bounds yet, refreshAssets() fills them in once it is ready
+			registry.emplace<LocalBounds>(entity, object.model->isReady() ? object.model->getBoundingSphere() : glm::vec4{ 0.0f });
+			registry.emplace<MeshHandle>(entity, object.model.get(), object.model->getId());
+			registry.emplace<MaterialHandle>(entity, object.material.get(), object.material->getId(), 0u);
+
+			//Handles don't own anything, so keep each model and material alive here
+			if (std::find(models.begin(), models.end(), object.model) == models.end())
+			{
+				models.push_back(object.model);
+			}
+			if (std::find(materials.begin(), materials.end(), object.material) == materials.end())
+			{
+				materials.push_back(object.material);
+			}
+		}
+
+		updateTransforms();
+	}
+
+	void Scene::updateTransforms()
+	{
+		changedNodes.clear();
+		transforms.update(changedNodes);
+
+		WorldMatrix* worldMatrices = objects.raw<WorldMatrix>();
+		for (uint32_t node : changedNodes)
+		{
+			uint32_t objectIndex = nodeObjects[node];
+			worldMatrices[objectIndex].value = transforms.getWorldMatrix(node);
+			markObjectDirty(objectIndex);
+		}
+	}
+
+	void Scene::createRecordingContexts()
+	{
+		QueueFamilyIndices queueFamilyIndices = device.findPhysicalQueueFamilies();
+
+		recordingContextsPerFrame = threadPool.getThreadCount() + 1;
+		recordingContexts.resize(recordingContextsPerFrame * FRAMEBUFFER_COUNT);
+		for (RecordingContext& context : recordingContexts)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &context.commandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create recording command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = context.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &context.commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate secondary command buffers!");
+			}
+		}
 	}
 
 	void Scene::createBRDF()
@@ -40,7 +133,8 @@ namespace rub
 
 	void Scene::createDescriptorSetLayout()
 	{
-		VkDescriptorSetLayoutBinding cameraBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+		VkDescriptorSetLayoutBinding cameraBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0);
 		VkDescriptorSetLayoutBinding sceneBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 		VkDescriptorSetLayoutBinding irradianceBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
 		VkDescriptorSetLayoutBinding prefilterBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3);
@@ -57,7 +151,8 @@ namespace rub
 		vkCreateDescriptorSetLayout(device.getDevice(), &sceneLayoutInfo, nullptr, &sceneSetLayout);
 
 		VkDescriptorSetLayoutBinding objectBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-		std::vector<VkDescriptorSetLayoutBinding> objectBindings = { objectBinding };
+		VkDescriptorSetLayoutBinding instanceBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1);
+		std::vector<VkDescriptorSetLayoutBinding> objectBindings = { objectBinding, instanceBinding };
 
 		VkDescriptorSetLayoutCreateInfo objectLayoutInfo{};
 		objectLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -72,10 +167,14 @@ namespace rub
 	void Scene::createFramebuffers()
 	{
 		size_t cameraSize = VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUCameraData)) * FRAMEBUFFER_COUNT;
-		device.createBuffer(cameraSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, cameraBuffer);
+		device.createMappedBuffer(cameraSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, cameraBuffer, (void**)&cameraData);
 
 		size_t sceneSize = VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUSceneData)) * FRAMEBUFFER_COUNT;
-		device.createBuffer(sceneSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, sceneBuffer);
+		device.createMappedBuffer(sceneSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, sceneBuffer, (void**)&sceneData);
+
+		//Zeroed copies never match real data, so the first update of each frame always writes
+		writtenCameraData.resize(FRAMEBUFFER_COUNT, GPUCameraData{});
+		writtenSceneData.resize(FRAMEBUFFER_COUNT, GPUSceneData{});
 
 		VkSamplerCreateInfo irradianceSamplerInfo = VkUtil::samplesCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, 1);
 		vkCreateSampler(device.getDevice(), &irradianceSamplerInfo, nullptr, &irradianceSampler);
@@ -122,55 +221,209 @@ namespace rub
 			vkUpdateDescriptorSets(device.getDevice(), setWrites.size(), setWrites.data(), 0, nullptr);
 		}
 
+		objectCapacity = std::max<size_t>(MAX_OBJECTS, objects.size());
+		size_t wordCount = (objectCapacity + 63) / 64;
+
 		objectDescriptorSets.resize(FRAMEBUFFER_COUNT);
 		objectBuffers.resize(FRAMEBUFFER_COUNT);
+		objectData.resize(FRAMEBUFFER_COUNT);
+		instanceBuffers.resize(FRAMEBUFFER_COUNT);
+		instanceData.resize(FRAMEBUFFER_COUNT);
+		writtenViewProjection.resize(FRAMEBUFFER_COUNT, glm::mat4{ 0.0f });
+		writtenInstances.resize(FRAMEBUFFER_COUNT);
+		//Nothing has been written yet, so every object starts dirty in every frame
+		dirtyObjects.resize(FRAMEBUFFER_COUNT, std::vector<uint64_t>(wordCount, ~0ull));
 		for (int i = 0; i < FRAMEBUFFER_COUNT; i++)
 		{
-			size_t bufferSize = sizeof(GPUObjectData) * MAX_OBJECTS;
-			device.createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, objectBuffers[i]);
+			size_t bufferSize = sizeof(GPUObjectData) * objectCapacity;
+			device.createMappedBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, objectBuffers[i], (void**)&objectData[i]);
+			size_t instanceSize = sizeof(uint32_t) * objectCapacity;
+			device.createMappedBuffer(instanceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, instanceBuffers[i], (void**)&instanceData[i]);
 			device.getDescriptor(objectSetLayout, objectDescriptorSets[i]);
 
 			VkDescriptorBufferInfo bufferInfo{};
 			bufferInfo.buffer = objectBuffers[i].buffer;
 			bufferInfo.range = bufferSize;
 
-			VkWriteDescriptorSet setWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectDescriptorSets[i], &bufferInfo, 0);
-			vkUpdateDescriptorSets(device.getDevice(), 1, &setWrite, 0, nullptr);
+			VkDescriptorBufferInfo instanceInfo{};
+			instanceInfo.buffer = instanceBuffers[i].buffer;
+			instanceInfo.range = instanceSize;
+
+			VkWriteDescriptorSet objectWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectDescriptorSets[i], &bufferInfo, 0);
+			VkWriteDescriptorSet instanceWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectDescriptorSets[i], &instanceInfo, 1);
+			std::vector<VkWriteDescriptorSet> setWrites = { objectWrite, instanceWrite };
+			vkUpdateDescriptorSets(device.getDevice(), setWrites.size(), setWrites.data(), 0, nullptr);
 		}
 	}
 
 	void Scene::updateBuffer(GPUCameraData data)
 	{
-		char* cameraData;
-		vmaMapMemory(device.getAllocator(), cameraBuffer.allocation, (void**)&cameraData);
-		cameraData += VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUCameraData)) * frameBufferIndex;
-		memcpy(cameraData, &data, sizeof(GPUCameraData));
-		vmaUnmapMemory(device.getAllocator(), cameraBuffer.allocation);
+		if (memcmp(&writtenCameraData[frameBufferIndex], &data, sizeof(GPUCameraData)) == 0)
+		{
+			return;
+		}
+		writtenCameraData[frameBufferIndex] = data;
+
+		size_t offset = VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUCameraData)) * frameBufferIndex;
+		memcpy(cameraData + offset, &data, sizeof(GPUCameraData));
+		vmaFlushAllocation(device.getAllocator(), cameraBuffer.allocation, offset, sizeof(GPUCameraData));
+		uploadBytes += sizeof(GPUCameraData);
 	}
 
 	void Scene::updateBuffer(GPUSceneData data)
 	{
-		char* sceneData;
-		vmaMapMemory(device.getAllocator(), sceneBuffer.allocation, (void**)&sceneData);
-		sceneData += VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUSceneData)) * frameBufferIndex;
-		memcpy(sceneData, &data, sizeof(GPUSceneData));
-		vmaUnmapMemory(device.getAllocator(), sceneBuffer.allocation);
+		if (memcmp(&writtenSceneData[frameBufferIndex], &data, sizeof(GPUSceneData)) == 0)
+		{
+			return;
+		}
+		writtenSceneData[frameBufferIndex] = data;
+
+		size_t offset = VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUSceneData)) * frameBufferIndex;
+		memcpy(sceneData + offset, &data, sizeof(GPUSceneData));
+		vmaFlushAllocation(device.getAllocator(), sceneBuffer.allocation, offset, sizeof(GPUSceneData));
+		uploadBytes += sizeof(GPUSceneData);
+	}
+
+	void Scene::markObjectDirty(size_t objectIndex)
+	{
+		for (std::vector<uint64_t>& dirty : dirtyObjects)
+		{
+			dirty[objectIndex / 64] |= 1ull << (objectIndex % 64);
+		}
+	}
+
+	void Scene::refreshViewProjection(glm::mat4& viewProjection)
+	{
+		//Every stored MVP depends on the camera, so a camera change makes every object in this frame's buffer stale
+		viewProjection = camera->getProjectionMatrix() * camera->getViewMatrix();
+		if (viewProjection != writtenViewProjection[frameBufferIndex])
+		{
+			writtenViewProjection[frameBufferIndex] = viewProjection;
+			std::fill(dirtyObjects[frameBufferIndex].begin(), dirtyObjects[frameBufferIndex].end(), ~0ull);
+		}
+	}
+
+	bool Scene::clearDirty(uint32_t objectIndex)
+	{
+		uint64_t& word = dirtyObjects[frameBufferIndex][objectIndex / 64];
+		uint64_t bit = 1ull << (objectIndex % 64);
+		if ((word & bit) == 0)
+		{
+			return false;
+		}
+		word &= ~bit;
+
+		return true;
+	}
+
+	void Scene::writeObjects(const glm::mat4* viewProjection)
+	{
+		if (pendingObjects.empty())
+		{
+			return;
+		}
+
+		//Model matrices are gathered into one contiguous array so every MVP comes out of a single batched multiply
+		size_t count = pendingObjects.size();
+		pendingModels.resize(count);
+		const WorldMatrix* worldMatrices = objects.raw<WorldMatrix>();
+		for (size_t i = 0; i < count; i++)
+		{
+			pendingModels[i] = worldMatrices[pendingObjects[i]].value;
+		}
+		if (viewProjection != nullptr)
+		{
+			pendingMVPs.resize(count);
+			TransformBatch::multiplyParallel(threadPool, *viewProjection, pendingModels.data(), pendingMVPs.data(), count);
+		}
+
+		//Pending indices are ascending, so consecutive written slots merge into one flush
+		GPUObjectData* entries = objectData[frameBufferIndex];
+		size_t rangeStart = 0;
+		size_t rangeCount = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t objectIndex = pendingObjects[i];
+			entries[objectIndex].modelMatrix = pendingModels[i];
+			if (viewProjection != nullptr)
+			{
+				entries[objectIndex].MVP = pendingMVPs[i];
+			}
+
+			if (rangeCount > 0 && objectIndex == rangeStart + rangeCount)
+			{
+				rangeCount++;
+			}
+			else
+			{
+				if (rangeCount > 0)
+				{
+					flushObjects(rangeStart, rangeCount);
+				}
+				rangeStart = objectIndex;
+				rangeCount = 1;
+			}
+		}
+		flushObjects(rangeStart, rangeCount);
+
+		uploadBytes += count * (viewProjection != nullptr ? sizeof(GPUObjectData) : sizeof(glm::mat4));
+		pendingObjects.clear();
+	}
+
+	void Scene::flushObjects(size_t first, size_t count)
+	{
+		vmaFlushAllocation(device.getAllocator(), objectBuffers[frameBufferIndex].allocation, first * sizeof(GPUObjectData), count * sizeof(GPUObjectData));
 	}
 
 	void Scene::updateObjectBuffer()
 	{
-		void* objectData;
-		vmaMapMemory(device.getAllocator(), objectBuffers[frameBufferIndex].allocation, &objectData);
-		GPUObjectData* objectSSBO = (GPUObjectData*)objectData;
+		glm::mat4 viewProjection;
+		refreshViewProjection(viewProjection);
+
+		//Visible indices come out of culling in ascending order, which keeps the pending list sorted
+		for (size_t i = 0; i < drawCommands.size(); i++)
+		{
+			if (clearDirty(visibleObjects[i]))
+			{
+				pendingObjects.push_back(visibleObjects[i]);
+			}
+		}
+		writeObjects(&viewProjection);
+
+		updateInstanceBuffer();
+	}
+
+	void Scene::updateInstanceBuffer()
+	{
+		//Only the span between the first and last changed instance is rewritten
+		std::vector<uint32_t>& written = writtenInstances[frameBufferIndex];
+		size_t first = drawCommands.size();
+		size_t last = 0;
+		for (size_t i = 0; i < drawCommands.size(); i++)
+		{
+			if (i >= written.size() || written[i] != drawCommands[i].objectIndex)
+			{
+				first = std::min(first, i);
+				last = i;
+			}
+		}
+		written.resize(drawCommands.size());
+
+		if (first == drawCommands.size())
+		{
+			return;
+		}
 
-		for (int i = 0; i < renderObjects.size(); i++)
+		uint32_t* instances = instanceData[frameBufferIndex];
+		for (size_t i = first; i <= last; i++)
 		{
-			auto& object = renderObjects[i];
-			objectSSBO[i].modelMatrix = object.transform.getMatrix();
-			objectSSBO[i].MVP = camera->getProjectionMatrix() * camera->getViewMatrix() * object.transform.getMatrix();
+			instances[i] = drawCommands[i].objectIndex;
+			written[i] = drawCommands[i].objectIndex;
 		}
 
-		vmaUnmapMemory(device.getAllocator(), objectBuffers[frameBufferIndex].allocation);
+		size_t count = last - first + 1;
+		vmaFlushAllocation(device.getAllocator(), instanceBuffers[frameBufferIndex].allocation, first * sizeof(uint32_t), count * sizeof(uint32_t));
+		uploadBytes += count * sizeof(uint32_t);
 	}
 
 	void Scene::bindScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
@@ -185,15 +438,28 @@ namespace rub
 
 	void Scene::bindObjects(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
 	{
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1,
-			&objectDescriptorSets[frameBufferIndex], 0, nullptr);
+		VkDescriptorSet& objectSet = drawPath == DrawPath::GpuDriven ? visibleObjectDescriptorSets[frameBufferIndex] : objectDescriptorSets[frameBufferIndex];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &objectSet, 0, nullptr);
 	}
 
-	void Scene::draw(VkCommandBuffer commandBuffer, VkRenderPass renderPass)
+	void Scene::update(int frameIndex)
 	{
-		for (RenderObject& object : renderObjects)
+		//Per-frame buffers are indexed by the renderer's frame in flight, whose fence has already been waited on
+		frameBufferIndex = frameIndex % FRAMEBUFFER_COUNT;
+		uploadBytes = 0;
+
+		//Only moved nodes and their children get new world matrices and object buffer writes
+		const TransformNode* nodes = objects.raw<TransformNode>();
+		glm::quat spin = glm::angleAxis(glm::radians(0.4f), glm::vec3(0, 1, 0));
+		for (size_t i = 0; i < objects.size(); i++)
 		{
-			object.transform.rotate(glm::vec3(0, 0.4f, 0));
+			transforms.rotate(nodes[i].node, spin);
+		}
+		updateTransforms();
+
+		if (!assetsResident)
+		{
+			refreshAssets();
 		}
 
 		//Update buffers
@@ -216,45 +482,564 @@ namespace rub
 		sceneData.lightCount = 0;
 		sceneData.prefilterMips = skybox->getPrefilterMipLevels();
 		updateBuffer(sceneData);
+	}
 
-		updateObjectBuffer();
+	void Scene::refreshAssets()
+	{
+		LocalBounds* bounds = objects.raw<LocalBounds>();
+		const MeshHandle* meshHandles = objects.raw<MeshHandle>();
 
-		//Draw render objects
-		for (int i = 0; i < renderObjects.size(); i++)
+		bool allReady = true;
+		for (size_t i = 0; i < objects.size(); i++)
 		{
-			RenderObject& object = renderObjects[i];
+			if (meshHandles[i].model->isReady())
+			{
+				bounds[i].sphere = meshHandles[i].model->getBoundingSphere();
+			}
+			else
+			{
+				allReady = false;
+			}
+		}
+		for (std::shared_ptr<Material>& material : materials)
+		{
+			allReady = allReady && material->isReady();
+		}
+
+		assetsResident = allReady;
 
-			std::shared_ptr<Material> material = object.material;
-			std::shared_ptr<Model> model = object.model;
+		//The batches are built from every model's draw ranges and bounds, so they wait for all of them
+		if (assetsResident && drawPath == DrawPath::GpuDriven && !objects.empty())
+		{
+			createGpuDrivenResources();
+		}
+	}
 
-			if (!material->isReady())
+	void Scene::draw(VkCommandBuffer commandBuffer, VkRenderPass renderPass)
+	{
+		//Pipelines and descriptor sets are created here so recording never touches shared device state
+		std::vector<VkDescriptorSetLayout> objectSetLayouts = { sceneSetLayout, objectSetLayout };
+		for (std::shared_ptr<Material>& material : materials)
+		{
+			if (!material->isReady() && material->areTexturesReady())
 			{
-				std::vector<VkDescriptorSetLayout> setLayouts = { sceneSetLayout, objectSetLayout };
-				material->setup(setLayouts, renderPass);
+				material->setModelMatrixOnly(drawPath == DrawPath::GpuDriven);
+				material->setup(objectSetLayouts, renderPass);
+			}
+		}
+
+		//Pipelines only exist after setup, and never change afterwards
+		if (!pipelineIdsCached)
+		{
+			pipelineIdsCached = true;
+			MaterialHandle* materialHandles = objects.raw<MaterialHandle>();
+			for (size_t i = 0; i < objects.size(); i++)
+			{
+				if (materialHandles[i].material->isReady())
+				{
+					materialHandles[i].pipelineId = materialHandles[i].material->getPipelineId();
+				}
+				else
+				{
+					pipelineIdsCached = false;
+				}
 			}
-			bindScene(commandBuffer, material->getLayout());
-			bindObjects(commandBuffer, material->getLayout());
-			material->bind(commandBuffer);
-			model->bind(commandBuffer);
-			model->draw(commandBuffer, i);
 		}
 
-		//Draw skybox last
 		std::shared_ptr<Material> skyboxMaterial = skybox->getMaterial();
 		if (!skyboxMaterial->isReady())
 		{
 			std::vector<VkDescriptorSetLayout> setLayouts = { sceneSetLayout };
 			skyboxMaterial->setup(setLayouts, renderPass);
 		}
-		bindScene(commandBuffer, skyboxMaterial->getLayout());
+
+		if (drawPath == DrawPath::GpuDriven)
+		{
+			//Batches are only built once every asset is resident
+			if (cullShader != nullptr)
+			{
+				recordBatches(commandBuffer);
+			}
+			recordSkybox(commandBuffer);
+			return;
+		}
+
+		buildDrawCommands();
+		updateObjectBuffer();
+
+		if (recordingMode == RecordingMode::Parallel)
+		{
+			recordParallel(commandBuffer, renderPass);
+		}
+		else
+		{
+			drawStats = recordObjects(commandBuffer, 0, drawCommands.size());
+			drawStats.culledCount = culledCount;
+			//Draw skybox last
+			recordSkybox(commandBuffer);
+		}
+	}
+
+	void Scene::buildDrawCommands()
+	{
+		glm::vec3 cameraPosition = camera->getPosition();
+
+		const WorldMatrix* worldMatrices = objects.raw<WorldMatrix>();
+		const LocalBounds* bounds = objects.raw<LocalBounds>();
+		const MeshHandle* meshHandles = objects.raw<MeshHandle>();
+		const MaterialHandle* materialHandles = objects.raw<MaterialHandle>();
+
+		//Cull first so the sort, object buffer and recording only ever see visible objects
+		worldSpheres.resize(objects.size());
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			FrustumCull::transformSphere(worldMatrices[i].value, bounds[i].sphere, worldSpheres, i);
+		}
+
+		Frustum frustum = FrustumCull::extractFrustum(camera->getProjectionMatrix() * camera->getViewMatrix());
+		visibleObjects.resize(objects.size());
+		size_t visibleCount = FrustumCull::cullSpheres(frustum, worldSpheres, visibleObjects.data());
+		culledCount = static_cast<uint32_t>(objects.size() - visibleCount);
+
+		//Objects whose model or textures are still loading are left out until they arrive
+		if (!assetsResident)
+		{
+			auto visibleEnd = std::remove_if(visibleObjects.begin(), visibleObjects.begin() + visibleCount, [&](uint32_t objectIndex)
+				{
+					return !meshHandles[objectIndex].model->isReady() || !materialHandles[objectIndex].material->isReady();
+				});
+			visibleCount = visibleEnd - visibleObjects.begin();
+		}
+
+		drawCommands.resize(visibleCount);
+		for (size_t i = 0; i < visibleCount; i++)
+		{
+			uint32_t objectIndex = visibleObjects[i];
+
+			//Front to back within a run of identical state so early depth testing rejects more
+			float depth = glm::length(glm::vec3(worldMatrices[objectIndex].value[3]) - cameraPosition);
+			drawCommands[i].sortKey = DrawSort::makeKey(materialHandles[objectIndex].pipelineId, materialHandles[objectIndex].id, meshHandles[objectIndex].id, depth);
+			drawCommands[i].objectIndex = objectIndex;
+		}
+
+		DrawSort::radixSort(drawCommands, sortScratch);
+	}
+
+	DrawStats Scene::recordObjects(VkCommandBuffer commandBuffer, size_t begin, size_t end)
+	{
+		DrawStats stats{};
+
+		//Every command buffer starts with no state bound, so tracking is local to this call
+		BindState state{};
+
+		const MeshHandle* meshHandles = objects.raw<MeshHandle>();
+		const MaterialHandle* materialHandles = objects.raw<MaterialHandle>();
+
+		size_t runEnd = begin;
+		for (size_t i = begin; i < end; i = runEnd)
+		{
+			Material* material = materialHandles[drawCommands[i].objectIndex].material;
+			Model* model = meshHandles[drawCommands[i].objectIndex].model;
+
+			//Sorting puts identical model and material pairs next to each other, so each run becomes one instanced draw
+			runEnd = i + 1;
+			while (runEnd < end)
+			{
+				uint32_t next = drawCommands[runEnd].objectIndex;
+				if (meshHandles[next].model != model || materialHandles[next].material != material)
+				{
+					break;
+				}
+				runEnd++;
+			}
+
+			bindState(commandBuffer, state, material, model, stats);
+			model->draw(commandBuffer, static_cast<uint32_t>(i), static_cast<uint32_t>(runEnd - i));
+			stats.drawCount++;
+			stats.instanceCount += static_cast<uint32_t>(runEnd - i);
+		}
+
+		return stats;
+	}
+
+	void Scene::bindState(VkCommandBuffer commandBuffer, BindState& state, Material* material, Model* model, DrawStats& stats)
+	{
+		if (material->getLayout() != state.layout)
+		{
+			state.layout = material->getLayout();
+			bindScene(commandBuffer, state.layout);
+			bindObjects(commandBuffer, state.layout);
+			stats.bindsIssued += 2;
+			//Sets bound through a different layout may be disturbed, so force the texture set to follow
+			state.material = nullptr;
+		}
+		else
+		{
+			stats.bindsSkipped += 2;
+		}
+
+		if (material->getPipelineId() != state.pipelineId)
+		{
+			material->bindPipeline(commandBuffer);
+			state.pipelineId = material->getPipelineId();
+			stats.bindsIssued++;
+		}
+		else
+		{
+			stats.bindsSkipped++;
+		}
+
+		if (material != state.material)
+		{
+			material->bindTextures(commandBuffer);
+			state.material = material;
+			stats.bindsIssued++;
+		}
+		else
+		{
+			stats.bindsSkipped++;
+		}
+
+		//Every model shares the arena's buffers, so they're only rebound when the index type changes
+		if (model->getIndexType() != state.indexType)
+		{
+			model->getGeometryArena().bind(commandBuffer, model->getIndexType());
+			state.indexType = model->getIndexType();
+			stats.bindsIssued++;
+		}
+		else
+		{
+			stats.bindsSkipped++;
+		}
+
+		if (model != state.model)
+		{
+			model->bindDecode(commandBuffer);
+			state.model = model;
+			stats.bindsIssued++;
+		}
+		else
+		{
+			stats.bindsSkipped++;
+		}
+	}
+
+	void Scene::recordBatches(VkCommandBuffer commandBuffer)
+	{
+		DrawStats stats{};
+		BindState state{};
+
+		//Instance counts were written by cull.comp, the CPU only walks the batches
+		for (const DrawBatch& batch : drawBatches)
+		{
+			bindState(commandBuffer, state, batch.material, batch.model, stats);
+			if (device.supportsMultiDrawIndirect())
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[frameBufferIndex].buffer, batch.firstCommand * sizeof(VkDrawIndexedIndirectCommand), 
+					batch.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+				stats.drawCount++;
+				continue;
+			}
+
+			//Without the feature every indirect draw is limited to a single command
+			for (uint32_t command = batch.firstCommand; command < batch.firstCommand + batch.commandCount; command++)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[frameBufferIndex].buffer, command * sizeof(VkDrawIndexedIndirectCommand), 1,
+					sizeof(VkDrawIndexedIndirectCommand));
+				stats.drawCount++;
+			}
+		}
+
+		drawStats = stats;
+	}
+
+	void Scene::createGpuDrivenResources()
+	{
+		const LocalBounds* bounds = objects.raw<LocalBounds>();
+		const MeshHandle* meshHandles = objects.raw<MeshHandle>();
+		const MaterialHandle* materialHandles = objects.raw<MaterialHandle>();
+
+		//Group objects into batches by material and model, ordered so batches sharing a material are adjacent
+		std::vector<std::pair<uint64_t, uint32_t>> batchKeys(objects.size());
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			uint64_t key = (static_cast<uint64_t>(materialHandles[i].id) << 32) | meshHandles[i].id;
+			batchKeys[i] = { key, static_cast<uint32_t>(i) };
+		}
+		std::sort(batchKeys.begin(), batchKeys.end());
+
+		std::vector<uint32_t> objectBatchIndices(objects.size());
+		std::vector<VkDrawIndexedIndirectCommand> templateCommands;
+		for (size_t i = 0; i < batchKeys.size(); i++)
+		{
+			uint32_t objectIndex = batchKeys[i].second;
+			if (i == 0 || batchKeys[i].first != batchKeys[i - 1].first)
+			{
+				Model* model = meshHandles[objectIndex].model;
+				const std::vector<Submesh>& drawRanges = model->getDrawRanges();
+				drawBatches.push_back({ materialHandles[objectIndex].material, model, static_cast<uint32_t>(i), static_cast<uint32_t>(templateCommands.size()),
+					static_cast<uint32_t>(drawRanges.size()) });
+
+				//Every range of a batch draws the same instances, so they share firstInstance
+				for (const Submesh& range : drawRanges)
+				{
+					VkDrawIndexedIndirectCommand command{};
+					command.indexCount = range.indexCount;
+					command.instanceCount = 0;
+					command.firstIndex = range.firstIndex;
+					command.vertexOffset = range.vertexOffset;
+					command.firstInstance = static_cast<uint32_t>(i);
+					templateCommands.push_back(command);
+				}
+			}
+			objectBatchIndices[objectIndex] = static_cast<uint32_t>(drawBatches.size() - 1);
+		}
+
+		VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * templateCommands.size();
+		void* templateData;
+		device.createMappedBuffer(commandsSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, batchTemplateBuffer, &templateData);
+		memcpy(templateData, templateCommands.data(), commandsSize);
+
+		VkDescriptorSetLayoutBinding objectBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		VkDescriptorSetLayoutBinding cullObjectBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		VkDescriptorSetLayoutBinding drawCommandBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2);
+		VkDescriptorSetLayoutBinding visibleInstanceBinding = VkUtil::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3);
+		std::vector<VkDescriptorSetLayoutBinding> cullBindings = { objectBinding, cullObjectBinding, drawCommandBinding, visibleInstanceBinding };
+
+		VkDescriptorSetLayoutCreateInfo cullLayoutInfo{};
+		cullLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		cullLayoutInfo.pNext = nullptr;
+		cullLayoutInfo.flags = 0;
+		cullLayoutInfo.bindingCount = cullBindings.size();
+		cullLayoutInfo.pBindings = cullBindings.data();
+
+		vkCreateDescriptorSetLayout(device.getDevice(), &cullLayoutInfo, nullptr, &cullSetLayout);
+
+		std::vector<VkDescriptorSetLayout> cullSetLayouts = { sceneSetLayout, cullSetLayout };
+		cullShader = std::make_unique<ComputeShader>(device, "shaders/cull.comp.spv", cullSetLayouts, sizeof(uint32_t));
+
+		//Bounds and batches never change, so the cull inputs are written once and shared by every frame
+		VkDeviceSize cullObjectsSize = sizeof(GPUCullObject) * objects.size();
+		GPUCullObject* cullObjects;
+		device.createMappedBuffer(cullObjectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, cullObjectBuffer, (void**)&cullObjects);
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			cullObjects[i].boundingSphere = bounds[i].sphere;
+			const DrawBatch& batch = drawBatches[objectBatchIndices[i]];
+			cullObjects[i].firstCommand = batch.firstCommand;
+			cullObjects[i].commandCount = batch.commandCount;
+		}
+		vmaFlushAllocation(device.getAllocator(), cullObjectBuffer.allocation, 0, cullObjectsSize);
+
+		//The visible instance buffer can hold every object if nothing is culled
+		VkDeviceSize objectsSize = sizeof(GPUObjectData) * objectCapacity;
+		VkDeviceSize visibleInstancesSize = sizeof(uint32_t) * objects.size();
+
+		drawCommandBuffers.resize(FRAMEBUFFER_COUNT);
+		visibleInstanceBuffers.resize(FRAMEBUFFER_COUNT);
+		cullDescriptorSets.resize(FRAMEBUFFER_COUNT);
+		visibleObjectDescriptorSets.resize(FRAMEBUFFER_COUNT);
+		for (int i = 0; i < FRAMEBUFFER_COUNT; i++)
+		{
+			device.createBuffer(commandsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+				VMA_MEMORY_USAGE_GPU_ONLY, drawCommandBuffers[i]);
+			device.createBuffer(visibleInstancesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, visibleInstanceBuffers[i]);
+
+			device.getDescriptor(cullSetLayout, cullDescriptorSets[i]);
+
+			VkDescriptorBufferInfo objectInfo{};
+			objectInfo.buffer = objectBuffers[i].buffer;
+			objectInfo.range = objectsSize;
+
+			VkDescriptorBufferInfo cullObjectInfo{};
+			cullObjectInfo.buffer = cullObjectBuffer.buffer;
+			cullObjectInfo.range = cullObjectsSize;
+
+			VkDescriptorBufferInfo drawCommandInfo{};
+			drawCommandInfo.buffer = drawCommandBuffers[i].buffer;
+			drawCommandInfo.range = commandsSize;
+
+			VkDescriptorBufferInfo visibleInstanceInfo{};
+			visibleInstanceInfo.buffer = visibleInstanceBuffers[i].buffer;
+			visibleInstanceInfo.range = visibleInstancesSize;
+
+			VkWriteDescriptorSet objectWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullDescriptorSets[i], &objectInfo, 0);
+			VkWriteDescriptorSet cullObjectWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullDescriptorSets[i], &cullObjectInfo, 1);
+			VkWriteDescriptorSet drawCommandWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullDescriptorSets[i], &drawCommandInfo, 2);
+			VkWriteDescriptorSet visibleInstanceWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cullDescriptorSets[i], &visibleInstanceInfo, 3);
+			std::vector<VkWriteDescriptorSet> setWrites = { objectWrite, cullObjectWrite, drawCommandWrite, visibleInstanceWrite };
+			vkUpdateDescriptorSets(device.getDevice(), setWrites.size(), setWrites.data(), 0, nullptr);
+
+			//pbr.vert reads the same object buffer, indirected through the instances the cull pass wrote
+			device.getDescriptor(objectSetLayout, visibleObjectDescriptorSets[i]);
+			VkWriteDescriptorSet visibleObjectWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, visibleObjectDescriptorSets[i], &objectInfo, 0);
+			VkWriteDescriptorSet visibleInstanceSetWrite = VkUtil::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, visibleObjectDescriptorSets[i], &visibleInstanceInfo, 1);
+			std::vector<VkWriteDescriptorSet> objectSetWrites = { visibleObjectWrite, visibleInstanceSetWrite };
+			vkUpdateDescriptorSets(device.getDevice(), objectSetWrites.size(), objectSetWrites.data(), 0, nullptr);
+		}
+	}
+
+	void Scene::cull(VkCommandBuffer commandBuffer)
+	{
+		//Resources are built by refreshAssets() once everything is resident
+		if (drawPath != DrawPath::GpuDriven || cullShader == nullptr)
+		{
+			return;
+		}
+
+		//Every object is a culling candidate here, so walk the dirty bits directly and skip clean words whole.
+		//Only model matrices are stored, cull.comp and pbr.vert apply the camera, so moving it dirties nothing
+		std::vector<uint64_t>& dirty = dirtyObjects[frameBufferIndex];
+		for (size_t word = 0; word * 64 < objects.size(); word++)
+		{
+			if (dirty[word] == 0)
+			{
+				continue;
+			}
+
+			size_t wordEnd = std::min(word * 64 + 64, objects.size());
+			for (size_t i = word * 64; i < wordEnd; i++)
+			{
+				if (clearDirty(static_cast<uint32_t>(i)))
+				{
+					pendingObjects.push_back(static_cast<uint32_t>(i));
+				}
+			}
+		}
+		writeObjects(nullptr);
+
+		//Reset every batch's instance count, culling then counts the visible objects back up
+		VkBufferCopy resetCopy{};
+		resetCopy.size = sizeof(VkDrawIndexedIndirectCommand) * (drawBatches.back().firstCommand + drawBatches.back().commandCount);
+		vkCmdCopyBuffer(commandBuffer, batchTemplateBuffer.buffer, drawCommandBuffers[frameBufferIndex].buffer, 1, &resetCopy);
+
+		VkBufferMemoryBarrier resetBarrier{};
+		resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.buffer = drawCommandBuffers[frameBufferIndex].buffer;
+		resetBarrier.offset = 0;
+		resetBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+		uint32_t cameraOffset = VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUCameraData)) * frameBufferIndex;
+		uint32_t sceneOffset = VkUtil::padUniformBufferSize(device.getDeviceProperties(), sizeof(GPUSceneData)) * frameBufferIndex;
+		std::vector<uint32_t> offsets = { cameraOffset, sceneOffset };
+
+		uint32_t objectCount = static_cast<uint32_t>(objects.size());
+		cullShader->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullShader->getLayout(), 0, 1, &sceneDescriptorSets[frameBufferIndex], 
+			offsets.size(), offsets.data());
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullShader->getLayout(), 1, 1, &cullDescriptorSets[frameBufferIndex], 0, nullptr);
+		cullShader->pushConstants(commandBuffer, &objectCount, sizeof(objectCount));
+		vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+
+		std::array<VkBufferMemoryBarrier, 2> cullBarriers{};
+		cullBarriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		cullBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		cullBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		cullBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		cullBarriers[0].buffer = drawCommandBuffers[frameBufferIndex].buffer;
+		cullBarriers[0].offset = 0;
+		cullBarriers[0].size = VK_WHOLE_SIZE;
+		cullBarriers[1] = cullBarriers[0];
+		cullBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		cullBarriers[1].buffer = visibleInstanceBuffers[frameBufferIndex].buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 
+			0, nullptr, cullBarriers.size(), cullBarriers.data(), 0, nullptr);
+	}
+
+	void Scene::recordSkybox(VkCommandBuffer commandBuffer)
+	{
+		bindScene(commandBuffer, skybox->getMaterial()->getLayout());
 		skybox->draw(commandBuffer);
+	}
+
+	void Scene::recordParallel(VkCommandBuffer commandBuffer, VkRenderPass renderPass)
+	{
+		RecordingContext* frameContexts = &recordingContexts[recordingContextsPerFrame * frameBufferIndex];
+		uint32_t chunkCount = recordingContextsPerFrame - 1;
+		size_t chunkSize = (drawCommands.size() + chunkCount - 1) / chunkCount;
+
+		//Chunks are contiguous ranges of the sorted commands, so each one still only binds on key changes
+		std::vector<DrawStats> chunkStats(chunkCount);
+		threadPool.parallelFor(chunkCount, [&](uint32_t chunk)
+			{
+				size_t begin = std::min(chunk * chunkSize, drawCommands.size());
+				size_t end = std::min(begin + chunkSize, drawCommands.size());
+
+				VkCommandBuffer secondary = beginSecondary(frameContexts[chunk], renderPass);
+				chunkStats[chunk] = recordObjects(secondary, begin, end);
+				if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to record secondary command buffer!");
+				}
+			});
+
+		drawStats = {};
+		drawStats.culledCount = culledCount;
+		for (const DrawStats& stats : chunkStats)
+		{
+			drawStats += stats;
+		}
 
-		//Increment frame count when new command buffer is passed in (meaning new frame has started)
-		if (currentBuffer != commandBuffer)
+		//Skybox is recorded last on this thread so it still draws after every object
+		VkCommandBuffer skyboxSecondary = beginSecondary(frameContexts[chunkCount], renderPass);
+		recordSkybox(skyboxSecondary);
+		if (vkEndCommandBuffer(skyboxSecondary) != VK_SUCCESS)
 		{
-			currentBuffer = commandBuffer;
-			frameBufferIndex = (frameBufferIndex + 1) % FRAMEBUFFER_COUNT;
+			throw std::runtime_error("failed to record secondary command buffer!");
 		}
+
+		std::vector<VkCommandBuffer> secondaries(recordingContextsPerFrame);
+		for (uint32_t i = 0; i < recordingContextsPerFrame; i++)
+		{
+			secondaries[i] = frameContexts[i].commandBuffer;
+		}
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+	}
+
+	VkCommandBuffer Scene::beginSecondary(RecordingContext& context, VkRenderPass renderPass)
+	{
+		//The renderer has waited on this frame's fence, so the pool's previous contents are no longer in use
+		vkResetCommandPool(device.getDevice(), context.commandPool, 0);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(context.commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		//Dynamic state isn't inherited from the primary
+		VkViewport viewport = swapChain->getViewport();
+		VkRect2D scissor = swapChain->getScissor();
+		vkCmdSetViewport(context.commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(context.commandBuffer, 0, 1, &scissor);
+
+		return context.commandBuffer;
+	}
+
+	VkSubpassContents Scene::getSubpassContents() const
+	{
+		//The GPU driven path records a handful of indirect draws, which isn't worth spreading across threads
+		if (drawPath == DrawPath::GpuDriven)
+		{
+			return VK_SUBPASS_CONTENTS_INLINE;
+		}
+		return recordingMode == RecordingMode::Parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
 	}
 
 	Scene::~Scene()
@@ -268,6 +1053,10 @@ namespace rub
 		{
 			vmaDestroyBuffer(device.getAllocator(), buffer.buffer, buffer.allocation);
 		}
+		for (AllocatedBuffer& buffer : instanceBuffers)
+		{
+			vmaDestroyBuffer(device.getAllocator(), buffer.buffer, buffer.allocation);
+		}
 
 		vkDestroySampler(device.getDevice(), irradianceSampler, nullptr);
 		vkDestroySampler(device.getDevice(), prefilterSampler, nullptr);
@@ -275,5 +1064,19 @@ namespace rub
 		vmaDestroyImage(device.getAllocator(), brdfImage.image, brdfImage.allocation);
 		vkDestroyImageView(device.getDevice(), brdfImageView, nullptr);
 		vkDestroySampler(device.getDevice(), brdfSampler, nullptr);
+
+		for (RecordingContext& context : recordingContexts)
+		{
+			vkDestroyCommandPool(device.getDevice(), context.commandPool, nullptr);
+		}
+
+		vkDestroyDescriptorSetLayout(device.getDevice(), cullSetLayout, nullptr);
+		vmaDestroyBuffer(device.getAllocator(), batchTemplateBuffer.buffer, batchTemplateBuffer.allocation);
+		vmaDestroyBuffer(device.getAllocator(), cullObjectBuffer.buffer, cullObjectBuffer.allocation);
+		for (size_t i = 0; i < drawCommandBuffers.size(); i++)
+		{
+			vmaDestroyBuffer(device.getAllocator(), drawCommandBuffers[i].buffer, drawCommandBuffers[i].allocation);
+			vmaDestroyBuffer(device.getAllocator(), visibleInstanceBuffers[i].buffer, visibleInstanceBuffers[i].allocation);
+		}
 	}
 }
\ No newline at end of file
@@ -6,12 +6,34 @@
 #include "swap_chain.hpp"
 #include "skybox.hpp"
 #include "compute_shader.hpp"
+#include "thread_pool.hpp"
+#include "draw_sort.hpp"
+#include "frustum_cull.hpp"
+#include "transform_batch.hpp"
+#include "transform_hierarchy.hpp"
+#include "scene_components.hpp"
+
+#include <entt/entity/registry.hpp>
+
+#include <limits>
 
 namespace rub
 {
 	class Scene
 	{
 	public:
+		enum class RecordingMode
+		{
+			Inline,
+			Parallel //Record render objects into secondary command buffers on the thread pool
+		};
+
+		enum class DrawPath
+		{
+			Direct, //Sorted and instanced draws recorded on the CPU
+			GpuDriven //A compute pass culls objects and writes one indirect draw per batch
+		};
+
 		struct GPUCameraData
 		{
 			glm::mat4 view;
@@ -36,19 +58,85 @@ namespace rub
 			glm::mat4 MVP;
 		};
 
-		Scene(Device& device, std::unique_ptr<SwapChain>& swapChain, std::shared_ptr<Camera> camera, const std::string& environmentPath, std::vector<RenderObject>& renderObjects);
+		//Static per object input to cull.comp, matches its std430 layout. Matrices come from the object buffer
+		struct GPUCullObject
+		{
+			glm::vec4 boundingSphere;
+			uint32_t firstCommand;
+			uint32_t commandCount;
+			uint32_t padding[2];
+		};
+
+		//The draw path is fixed for the scene's lifetime, material pipelines and the cull resources are built for it
+		Scene(Device& device, std::unique_ptr<SwapChain>& swapChain, ThreadPool& threadPool, GeometryArena& geometryArena, std::shared_ptr<Camera> camera, const std::string& environmentPath, 
+			std::vector<RenderObject>& renderObjects, DrawPath drawPath);
 		~Scene();
 
+		//Per frame CPU work, called before anything is recorded for the frame
+		void update(int frameIndex);
+		//Work that has to be recorded outside the render pass. Only does anything on the GPU driven path
+		void cull(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer, VkRenderPass renderPass);
+		void setRecordingMode(RecordingMode mode) { recordingMode = mode; }
+		VkSubpassContents getSubpassContents() const;
+		//Counters for the most recently recorded frame
+		const DrawStats& getDrawStats() const { return drawStats; }
+		//Bytes written to mapped buffers during the most recent frame
+		VkDeviceSize getUploadBytes() const { return uploadBytes; }
+		//Flags an object whose transform changed so its entry is rewritten in every frame's buffer
+		void markObjectDirty(size_t objectIndex);
 		void updateBuffer(GPUCameraData data);
 		void updateBuffer(GPUSceneData data);
 
 	private:
+		struct RecordingContext
+		{
+			VkCommandPool commandPool;
+			VkCommandBuffer commandBuffer;
+		};
+
+		//What is currently bound in a command buffer, so consecutive draws only rebind what changed
+		struct BindState
+		{
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			uint32_t pipelineId = std::numeric_limits<uint32_t>::max();
+			Material* material = nullptr;
+			Model* model = nullptr;
+			VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+		};
+
+		//All objects sharing a material and model, drawn with one indirect command per draw range of the model
+		struct DrawBatch
+		{
+			Material* material;
+			Model* model;
+			uint32_t firstInstance;
+			uint32_t firstCommand;
+			uint32_t commandCount;
+		};
+
+		//Full owning group, so every component array is packed in the same order and index i is the same object in each
+		using ObjectGroup = entt::basic_group<entt::entity, entt::exclude_t<>, entt::get_t<>, TransformNode, WorldMatrix, LocalBounds, MeshHandle, MaterialHandle>;
+
 		Device& device;
+		std::unique_ptr<SwapChain>& swapChain;
+		ThreadPool& threadPool;
 
 		std::shared_ptr<Camera> camera;
 		std::unique_ptr<Cubemap> globalCubemap;
-		std::vector<RenderObject> renderObjects;
+		//Objects are only created in the constructor, so their position in the group doubles as their object buffer slot
+		entt::registry registry;
+		ObjectGroup objects;
+		std::vector<std::shared_ptr<Model>> models;
+		std::vector<std::shared_ptr<Material>> materials;
+		bool pipelineIdsCached = false;
+		//Set once every model and material is ready, until then unready objects are skipped and bounds are refreshed each frame
+		bool assetsResident = false;
+
+		TransformHierarchy transforms;
+		//Object index for each node handle
+		std::vector<uint32_t> nodeObjects;
+		std::vector<uint32_t> changedNodes;
 
 		std::unique_ptr<Skybox> skybox;
 		VkSampler irradianceSampler;
@@ -57,11 +145,31 @@ namespace rub
 		VkDescriptorSetLayout sceneSetLayout;
 		AllocatedBuffer cameraBuffer;
 		AllocatedBuffer sceneBuffer;
+		char* cameraData;
+		char* sceneData;
 		std::vector<VkDescriptorSet> sceneDescriptorSets;
 
+		//Objects keep a fixed slot in the object buffer, draw order goes through the instance buffer
 		VkDescriptorSetLayout objectSetLayout;
 		std::vector<AllocatedBuffer> objectBuffers;
+		std::vector<GPUObjectData*> objectData;
+		std::vector<AllocatedBuffer> instanceBuffers;
+		std::vector<uint32_t*> instanceData;
 		std::vector<VkDescriptorSet> objectDescriptorSets;
+		size_t objectCapacity;
+
+		//Copies of what each frame's mapped buffers last received, so unchanged data is never written again
+		std::vector<GPUCameraData> writtenCameraData;
+		std::vector<GPUSceneData> writtenSceneData;
+		std::vector<glm::mat4> writtenViewProjection;
+		std::vector<std::vector<uint32_t>> writtenInstances;
+		//One bit per object for each frame in flight, set while that frame's entry is stale
+		std::vector<std::vector<uint64_t>> dirtyObjects;
+		//Dirty objects collected for this frame's write, with scratch for their matrices
+		std::vector<uint32_t> pendingObjects;
+		std::vector<glm::mat4> pendingModels;
+		std::vector<glm::mat4> pendingMVPs;
+		VkDeviceSize uploadBytes = 0;
 
 		std::unique_ptr<ComputeShader> brdfShader;
 		AllocatedImage brdfImage;
@@ -73,12 +181,55 @@ namespace rub
 		void createDescriptorSetLayout();
 		void createFramebuffers();
 		void createBRDF();
+		void createRecordingContexts();
+		void createObjects(std::vector<RenderObject>& renderObjects);
+		void updateTransforms();
+		void refreshAssets();
+
+		void buildDrawCommands();
+		DrawStats recordObjects(VkCommandBuffer commandBuffer, size_t begin, size_t end);
+		void recordSkybox(VkCommandBuffer commandBuffer);
+		void recordBatches(VkCommandBuffer commandBuffer);
+		void bindState(VkCommandBuffer commandBuffer, BindState& state, Material* material, Model* model, DrawStats& stats);
+		void createGpuDrivenResources();
+		void recordParallel(VkCommandBuffer commandBuffer, VkRenderPass renderPass);
+		VkCommandBuffer beginSecondary(RecordingContext& context, VkRenderPass renderPass);
 
 		void updateObjectBuffer();
+		void updateInstanceBuffer();
+		bool clearDirty(uint32_t objectIndex);
+		//Without a view projection only model matrices are written, as the GPU driven path reads nothing else
+		void writeObjects(const glm::mat4* viewProjection);
+		void flushObjects(size_t first, size_t count);
+		void refreshViewProjection(glm::mat4& viewProjection);
 
 		const int FRAMEBUFFER_COUNT = 1;
 		int frameBufferIndex = 0;
-		VkCommandBuffer currentBuffer;
+
+		RecordingMode recordingMode = RecordingMode::Inline;
+		//One pool per chunk per frame in flight so workers never share a pool, plus one for the skybox
+		std::vector<RecordingContext> recordingContexts;
+		uint32_t recordingContextsPerFrame;
+
+		//Render objects in bind order, rebuilt every frame
+		std::vector<DrawCommand> drawCommands;
+		std::vector<DrawCommand> sortScratch;
+		BoundingSpheres worldSpheres;
+		std::vector<uint32_t> visibleObjects;
+		uint32_t culledCount = 0;
+		DrawStats drawStats;
+
+		const DrawPath drawPath;
+		std::unique_ptr<ComputeShader> cullShader;
+		VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+		std::vector<DrawBatch> drawBatches;
+		//Indirect commands with zeroed instance counts, copied over each frame's commands before culling
+		AllocatedBuffer batchTemplateBuffer{};
+		AllocatedBuffer cullObjectBuffer{};
+		std::vector<AllocatedBuffer> drawCommandBuffers;
+		std::vector<AllocatedBuffer> visibleInstanceBuffers;
+		std::vector<VkDescriptorSet> cullDescriptorSets;
+		std::vector<VkDescriptorSet> visibleObjectDescriptorSets;
 		const int MAX_OBJECTS = 10000;
 	};
 }
\ No newline at end of file
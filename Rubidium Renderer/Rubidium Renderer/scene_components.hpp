@@ -0,0 +1,43 @@
+#pragma once
+
+#include "model.hpp"
+#include "material.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rub
+{
+	//Components for scene objects. Each one is kept small and plain so a group can stream them as packed arrays
+
+	//Handle of the object's node in the scene's transform hierarchy
+	struct TransformNode
+	{
+		uint32_t node;
+	};
+
+	//Copied out of the hierarchy whenever the node changes, so the hot loops read it packed alongside everything else
+	struct WorldMatrix
+	{
+		glm::mat4 value;
+	};
+
+	//Model space bounding sphere, copied out of the model so culling never dereferences it
+	struct LocalBounds
+	{
+		glm::vec4 sphere;
+	};
+
+	//Non-owning, the scene holds the shared_ptrs. Ids are cached so sort keys and batching never dereference either
+	struct MeshHandle
+	{
+		Model* model;
+		uint32_t id;
+	};
+
+	struct MaterialHandle
+	{
+		Material* material;
+		uint32_t id;
+		uint32_t pipelineId; //Only valid once the material has been set up
+	};
+}
\ No newline at end of file
@@ -1,3 +1,12 @@
-%VULKAN_SDK%/Bin32/glslc.exe shader.vert -o vert.spv
-%VULKAN_SDK%/Bin32/glslc.exe shader.frag -o frag.spv
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o brdf.comp.spv brdf.comp
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o cull.comp.spv cull.comp
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o spd.comp.spv spd.comp
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o pbr.vert.spv pbr.vert
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o pbr.frag.spv pbr.frag
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o skybox.vert.spv skybox.vert
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o skybox.frag.spv skybox.frag
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o cubemap.vert.spv cubemap.vert
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o equi_to_cube.frag.spv equi_to_cube.frag
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o irradiance_convolution.frag.spv irradiance_convolution.frag
+%VULKAN_SDK%/Bin/glslangValidator.exe -V -o prefilter.frag.spv prefilter.frag
 pause
\ No newline at end of file
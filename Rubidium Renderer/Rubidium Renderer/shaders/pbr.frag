@@ -85,7 +85,10 @@ vec3 aces(vec3 x)
 
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalMap, texCoord).xyz * 2.0 - 1.0;
+    //Cooked normal maps are BC5 with only X and Y, so Z is rebuilt for them and the uncompressed ones alike
+    vec3 tangentNormal;
+    tangentNormal.xy = texture(normalMap, texCoord).xy * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
 
     vec3 Q1  = dFdx(inWorldPos);
     vec3 Q2  = dFdy(inWorldPos);
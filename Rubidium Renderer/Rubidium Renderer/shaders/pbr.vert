@@ -15,27 +15,60 @@ layout(std140, set = 1, binding = 0) readonly buffer ObjectBuffer{
 	ObjectData objects[];
 } objectBuffer;
 
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer{
+	uint objectIndices[];
+} instanceBuffer;
+
+layout(constant_id = 0) const bool COMPACT_VERTICES = false;
+//The GPU driven path only stores model matrices, MVP is left unwritten and the camera is applied here
+layout(constant_id = 1) const bool MODEL_MATRIX_ONLY = false;
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
-layout(location = 3) in vec3 color;
+layout(location = 4) in vec3 positionOffset;
+layout(location = 5) in vec3 positionScale;
 
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec3 outWorldPos;
 layout(location = 3) out vec2 outTexCoord;
 
+//Octahedral normals come in as snorm xy, the lower hemisphere folded out over the corners
+vec3 decodeNormal(vec3 encoded)
+{
+	if (!COMPACT_VERTICES)
+	{
+		return encoded;
+	}
+
+	vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-n.z, 0.0);
+	n.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
 void main() 
 {
 	//debugPrintfEXT("%f ", objectBuffer.objects[gl_InstanceIndex].modelMatrix[3][0]);
 	//debugPrintfEXT("%i ", gl_BaseInstance);
-	outColor = color;
-	outWorldPos = vec3(objectBuffer.objects[gl_BaseInstance].modelMatrix * vec4(position, 1.0));
-    outNormal = mat3(objectBuffer.objects[gl_BaseInstance].modelMatrix) * normal;
+	outColor = vec3(1.0);
+	vec3 objectPosition = positionOffset + position * positionScale;
+	//gl_InstanceIndex is firstInstance + instance, so instanced runs walk their contiguous slice of the instance buffer
+	uint objectIndex = instanceBuffer.objectIndices[gl_InstanceIndex];
+	outWorldPos = vec3(objectBuffer.objects[objectIndex].modelMatrix * vec4(objectPosition, 1.0));
+    outNormal = mat3(objectBuffer.objects[objectIndex].modelMatrix) * decodeNormal(normal);
 	//outNormal = normal;
 	outTexCoord = texCoord;
 	//outMaterialAlbedo = vec4(1, 1, 1, 1);
 	//outMaterialMaskMap = vec4(1, 1, 1, 1);
 
-	gl_Position = objectBuffer.objects[gl_BaseInstance].MVP * vec4(position, 1.0);
+	if (MODEL_MATRIX_ONLY)
+	{
+		gl_Position = cameraData.projection * cameraData.view * vec4(outWorldPos, 1.0);
+	}
+	else
+	{
+		gl_Position = objectBuffer.objects[objectIndex].MVP * vec4(objectPosition, 1.0);
+	}
 }
\ No newline at end of file
@@ -3,7 +3,8 @@
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUV;
-layout(location = 3) in vec3 inColor;
+layout(location = 4) in vec3 inPositionOffset;
+layout(location = 5) in vec3 inPositionScale;
 
 layout(set = 0, binding = 0) uniform CameraBuffer {
 	mat4 view;
@@ -15,7 +16,7 @@ layout(location = 0) out vec3 outPos;
 
 void main()
 {
-    outPos = inPos;
+    outPos = inPositionOffset + inPos * inPositionScale;
 
     mat4 rotView = mat4(mat3(cameraData.view)); // remove translation from the view matrix
     vec4 clipPos = cameraData.projection * rotView * vec4(outPos, 1.0);
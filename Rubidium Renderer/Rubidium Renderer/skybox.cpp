@@ -2,12 +2,12 @@
 
 namespace rub
 {
-	Skybox::Skybox(Device& device, const std::string& environmentPath) : device{ device }
+	Skybox::Skybox(Device& device, GeometryArena& geometryArena, const std::string& environmentPath, ThreadPool* threadPool) : device{ device }
 	{
-		skyboxModel = std::make_shared<Model>(device, "models/cube.obj");
-		cubemap = std::make_unique<Cubemap>(device);
+		skyboxModel = std::make_shared<Model>(device, geometryArena, "models/cube.obj");
+		cubemap = std::make_unique<Cubemap>(device, geometryArena);
 
-		equiToCube(environmentPath);
+		equiToCube(environmentPath, threadPool);
 		
 		std::shared_ptr<Texture> skyboxTexture = std::make_shared<Texture>(device, cubemap->getCaptureImageView(), cubemap->getCaptureMipLevels());
 		std::shared_ptr<Material> skyboxMaterial = std::make_shared<Material>(device, "shaders/skybox.vert.spv", "shaders/skybox.frag.spv");
@@ -20,9 +20,9 @@ namespace rub
 		skyboxObject.material = skyboxMaterial;
 	}
 
-	void Skybox::equiToCube(const std::string& environmentPath)
+	void Skybox::equiToCube(const std::string& environmentPath, ThreadPool* threadPool)
 	{
-		std::shared_ptr<Texture> equiTexture = std::make_shared<Texture>(device, environmentPath, Texture::Format::HDR);
+		std::shared_ptr<Texture> equiTexture = std::make_shared<Texture>(device, environmentPath, Texture::Format::HDR, threadPool);
 		std::shared_ptr<Material> equiMaterial = std::make_shared<Material>(device, "shaders/cubemap.vert.spv", "shaders/equi_to_cube.frag.spv");
 		equiMaterial->addTexture(equiTexture);
 
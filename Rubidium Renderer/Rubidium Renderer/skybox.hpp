@@ -8,7 +8,8 @@ namespace rub
 	class Skybox
 	{
 	public:
-		Skybox(Device& device, const std::string& environmentPath);
+		//The environment's EXR blocks are decoded on threadPool when one is given
+		Skybox(Device& device, GeometryArena& geometryArena, const std::string& environmentPath, ThreadPool* threadPool = nullptr);
 		~Skybox();
 
 		void draw(VkCommandBuffer commandBuffer);
@@ -24,6 +25,6 @@ namespace rub
 		std::unique_ptr<Cubemap> cubemap;
 		RenderObject skyboxObject{};
 
-		void equiToCube(const std::string& environmentPath);
+		void equiToCube(const std::string& environmentPath, ThreadPool* threadPool);
 	};
 }
\ No newline at end of file
@@ -24,11 +24,14 @@ namespace rub
 		uint32_t width() { return swapChainExtent.width; }
 		uint32_t height() { return swapChainExtent.height; }
 
+		VkViewport getViewport();
+		VkRect2D getScissor() { return { {0, 0}, swapChainExtent }; }
+
 		float getExtentAspectRatio() { return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height); }
 		VkFormat findDepthFormat();
 
 		VkResult acquireNextImage(uint32_t* imageIndex);
-		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, VkFence inFlightFence);
 
 	private:
 		VkFormat swapChainImageFormat;
@@ -50,7 +53,6 @@ namespace rub
 
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
 		std::vector<VkFence> imagesInFlight;
 		size_t currentFrame = 0;
 
@@ -2,109 +2,206 @@
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h""
-#define TINYEXR_IMPLEMENTATION
-#include "tinyexr.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 
+#include "exr_decoder.hpp"
+#include "mip_downsampler.hpp"
+#include "upload_batcher.hpp"
 #include "vk_util.hpp"
 
 namespace rub
 {
-	Texture::Texture(Device& device, const std::string& file, Format format) : device{ device }
+	Texture::Texture(Device& device, const std::string& file, Format format, ThreadPool* threadPool) : device{ device }, format{ format }, threadPool{ threadPool }
 	{
-		if (format == Format::HDR)
-		{
-			if (createHDRImage(file))
-				createImageView(format);
-		}
-		else
-		{
-			if (createSDRImage(file, format))
-				createImageView(format);
-		}		
+		decode(file);
+		upload();
 	}
 
-	Texture::Texture(Device& device, VkImageView imageView, int mipLevels) : device{ device }, imageView{ imageView }, mipLevels{ mipLevels }
+	Texture::Texture(Device& device, Format format) : device{ device }, format{ format }
 	{
-		ownsImage = false;
+
 	}
 
-	bool Texture::createHDRImage(const std::string& file)
+	Texture::Texture(Device& device, VkImageView imageView, int mipLevels) : device{ device }, imageView{ imageView }, mipLevels{ mipLevels }, uploadValue{ 0 }
 	{
-		float* pixels; // width * height * RGBA
-		int width, height;
-		const char* err = nullptr;
+		ownsImage = false;
+	}
 
-		int ret = LoadEXR(&pixels, &width, &height, file.c_str(), &err);
+	void Texture::decode(const std::string& file)
+	{
+		if (std::filesystem::path(file).extension() == ".ktx2")
+		{
+			decodeKTX2(file);
+			return;
+		}
 
-		if (ret != TINYEXR_SUCCESS)
+		if (device.supportsBlockCompression())
 		{
-			if (err)
+			std::string cookedFile = Ktx2File::getCookedPath(file);
+			std::error_code error;
+			std::filesystem::file_time_type cookedTime = std::filesystem::last_write_time(cookedFile, error);
+			//A missing source still loads its cooked file, a missing cooked file leaves the error set and falls through
+			if (!error)
 			{
-				fprintf(stderr, "ERR : %s\n", err);
-				FreeEXRErrorMessage(err); // release memory of error message.
+				std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(file, error);
+				if ((error || cookedTime >= sourceTime) && decodeKTX2(cookedFile))
+				{
+					return;
+				}
 			}
+		}
 
-			return false;
+		if (format == Format::HDR)
+		{
+			decodeHDR(file);
 		}
 		else
 		{
-			VkDeviceSize imageSize = width * height * sizeof(pixels[0]) * 4;
+			decodeSDR(file);
+		}
+	}
 
-			AllocatedBuffer stagingBuffer;
-			device.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer);
+	bool Texture::decodeKTX2(const std::string& file)
+	{
+		std::unique_ptr<Ktx2File> ktx2 = std::make_unique<Ktx2File>();
+		if (!ktx2->open(file))
+		{
+			std::cout << "Failed to load cooked texture " << file << std::endl;
+			return false;
+		}
 
-			void* data;
-			vmaMapMemory(device.getAllocator(), stagingBuffer.allocation, &data);
-			memcpy(data, pixels, static_cast<size_t>(imageSize));
-			vmaUnmapMemory(device.getAllocator(), stagingBuffer.allocation);
+		width = static_cast<int>(ktx2->getWidth());
+		height = static_cast<int>(ktx2->getHeight());
+		cooked = std::move(ktx2);
+		return true;
+	}
 
-			free(pixels);
+	void Texture::decodeHDR(const std::string& file)
+	{
+		ExrDecoder decoder(threadPool);
+		if (!decoder.open(file))
+		{
+			return;
+		}
 
-			transferToGPU(width, height, Format::HDR, stagingBuffer);
+		//The format is picked before decoding so the blocks are written once, straight into the buffer that gets staged
+		width = static_cast<int>(decoder.getWidth());
+		height = static_cast<int>(decoder.getHeight());
+		imageFormat = selectHDRFormat({ decoder.getWidth(), decoder.getHeight() });
+		size_t texelSize = imageFormat == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 ? sizeof(uint32_t) : imageFormat == VK_FORMAT_R16G16B16A16_SFLOAT ? sizeof(uint16_t) * 4 : sizeof(float) * 4;
+		imageSize = static_cast<VkDeviceSize>(decoder.getWidth()) * decoder.getHeight() * texelSize;
 
-			return true;
+		void* decoded = malloc(imageSize);
+		if (!decoder.decode(imageFormat, decoded))
+		{
+			std::cout << "Failed to decode texture file " << file << std::endl;
+			free(decoded);
+			return;
 		}
+
+		pixels = decoded;
+		freePixels = free;
 	}
 
-	bool Texture::createSDRImage(const std::string& file, Format format)
+	VkFormat Texture::selectHDRFormat(VkExtent2D extent)
 	{
-		int texWidth, texHeight, texChannels;
+		//E5B9G9R9 can't be a storage image, so a format the downsampler can fill wins over it while the chain is generated
+		for (VkFormat candidate : HDR_STORAGE_FORMATS)
+		{
+			if (device.isFormatSupported(candidate, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) &&
+				(!GENERATE_MIPS || MipDownsampler::isSupported(device, candidate, extent)))
+			{
+				return candidate;
+			}
+		}
 
-		stbi_uc* pixels = stbi_load(file.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		//Past the downsampler, an image too large for it for one, the smallest format whose chain can be blitted keeps the mips
+		for (VkFormat candidate : HDR_STORAGE_FORMATS)
+		{
+			if (device.isFormatSupported(candidate, VK_IMAGE_TILING_OPTIMAL, UploadBatcher::BLIT_MIP_FEATURES))
+			{
+				return candidate;
+			}
+		}
 
-		if (!pixels)
+		//Nothing keeps the chain, so settle for the smallest that can be sampled
+		for (VkFormat candidate : HDR_STORAGE_FORMATS)
 		{
-			std::cout << "Failed to load texture file " << file << std::endl;
-			return false;
+			if (device.isFormatSupported(candidate, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+			{
+				return candidate;
+			}
 		}
+		return (VkFormat)Format::HDR;
+	}
 
-		void* pixel_ptr = pixels;
-		VkDeviceSize imageSize = texWidth * texHeight * sizeof(pixels[0]) * 4;
+	void Texture::decodeSDR(const std::string& file)
+	{
+		int texChannels;
 
-		AllocatedBuffer stagingBuffer;
-		device.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer);
+		stbi_uc* sdrPixels = stbi_load(file.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
 
-		void* data;
-		vmaMapMemory(device.getAllocator(), stagingBuffer.allocation, &data);
-		memcpy(data, pixel_ptr, static_cast<size_t>(imageSize));
-		vmaUnmapMemory(device.getAllocator(), stagingBuffer.allocation);
+		if (!sdrPixels)
+		{
+			std::cout << "Failed to load texture file " << file << std::endl;
+			return;
+		}
 
-		stbi_image_free(pixels);
+		pixels = sdrPixels;
+		freePixels = stbi_image_free;
+		imageFormat = (VkFormat)format;
+		imageSize = width * height * sizeof(sdrPixels[0]) * 4;
+	}
 
-		transferToGPU(texWidth, texHeight, format, stagingBuffer);		
+	void Texture::upload()
+	{
+		if (cooked)
+		{
+			transferCookedToGPU();
+			cooked.reset();
+			return;
+		}
 
-		return true;
+		//A failed decode has already said why, the texture just never becomes ready
+		if (pixels == nullptr)
+		{
+			return;
+		}
+
+		transferToGPU(width, height, imageFormat, pixels, imageSize);
+		createImageView(imageFormat);
+
+		freePixels(pixels);
+		pixels = nullptr;
 	}
 
-	void Texture::transferToGPU(const int width, const int height, Format format, AllocatedBuffer& stagingBuffer)
+	void Texture::transferToGPU(const int width, const int height, VkFormat format, const void* pixels, VkDeviceSize imageSize)
 	{
 		VkExtent2D imageExtent;
 		imageExtent.width = static_cast<uint32_t>(width);
 		imageExtent.height = static_cast<uint32_t>(height);
 
-		VkImageCreateInfo createInfo = VkUtil::imageCreateInfo((VkFormat)format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, 1);
+		//The chain is filled by the compute downsampler, which needs linear filtering and storage writes the format may not have.
+		//Where it can't be used, linear blits fill it instead
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VkImageCreateFlags flags = 0;
+		if (GENERATE_MIPS && MipDownsampler::isSupported(device, format, imageExtent))
+		{
+			mipLevels = VkUtil::calculateMipLevels(imageExtent.width, imageExtent.height);
+			usage |= MipDownsampler::IMAGE_USAGE;
+			flags |= MipDownsampler::imageCreateFlags(format);
+		}
+		else if (GENERATE_MIPS && device.isFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, UploadBatcher::BLIT_MIP_FEATURES))
+		{
+			mipLevels = VkUtil::calculateMipLevels(imageExtent.width, imageExtent.height);
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+
+		VkImageCreateInfo createInfo = VkUtil::imageCreateInfo(format, usage, imageExtent, mipLevels);
+		createInfo.flags = flags;
 
 		AllocatedImage newImage;
 
@@ -112,70 +209,79 @@ namespace rub
 		allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 		vmaCreateImage(device.getAllocator(), &createInfo, &allocationInfo, &newImage.image, &newImage.allocation, nullptr);
 
-		transitionImageLayout(stagingBuffer, newImage, format, imageExtent);
+		//The pixels are copied into the staging ring here, so the caller can free them straight away
+		device.getUploadBatcher().uploadImage(newImage.image, format, imageExtent, static_cast<uint32_t>(mipLevels), pixels, imageSize);
+		uploadValue = device.getUploadBatcher().getUploadValue();
 
-		vmaDestroyBuffer(device.getAllocator(), stagingBuffer.buffer, stagingBuffer.allocation);
+		allocatedImage = newImage;
+	}
+
+	void Texture::transferCookedToGPU()
+	{
+		VkFormat cookedFormat = static_cast<VkFormat>(cooked->getFormat());
+		if (!device.isFormatSupported(cookedFormat, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			std::cout << "Failed to find support for cooked texture format " << cookedFormat << std::endl;
+			return;
+		}
+
+		VkExtent2D imageExtent;
+		imageExtent.width = cooked->getWidth();
+		imageExtent.height = cooked->getHeight();
+		mipLevels = static_cast<int>(cooked->getLevelCount());
+
+		//The file stores the smallest level first with the rest following in order, so the whole chain is one contiguous range
+		const Ktx2File::Level& smallest = cooked->getLevel(cooked->getLevelCount() - 1);
+		const Ktx2File::Level& largest = cooked->getLevel(0);
+		std::vector<UploadBatcher::ImageLevel> levels(mipLevels);
+		for (uint32_t level = 0; level < levels.size(); level++)
+		{
+			levels[level].offset = static_cast<VkDeviceSize>(cooked->getLevel(level).data - smallest.data);
+			levels[level].extent.width = std::max(imageExtent.width >> level, 1u);
+			levels[level].extent.height = std::max(imageExtent.height >> level, 1u);
+		}
+		VkDeviceSize dataSize = static_cast<VkDeviceSize>(largest.data + largest.size - smallest.data);
+
+		VkImageCreateInfo createInfo = VkUtil::imageCreateInfo(cookedFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, mipLevels);
+
+		AllocatedImage newImage;
+
+		VmaAllocationCreateInfo allocationInfo = {};
+		allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		vmaCreateImage(device.getAllocator(), &createInfo, &allocationInfo, &newImage.image, &newImage.allocation, nullptr);
+
+		//Staged here as well, so the mapping can close as soon as this returns
+		device.getUploadBatcher().uploadImageLevels(newImage.image, smallest.data, dataSize, levels);
+		uploadValue = device.getUploadBatcher().getUploadValue();
 
 		allocatedImage = newImage;
+		createImageView(cookedFormat);
 	}
 
-	void Texture::transitionImageLayout(AllocatedBuffer staging, AllocatedImage newImage, Format format, VkExtent2D imageExtent)
+	bool Texture::isReady()
 	{
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-		VkImageSubresourceRange range;
-		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		range.baseMipLevel = 0;
-		range.levelCount = 1;
-		range.baseArrayLayer = 0;
-		range.layerCount = 1;
-
-		VkImageMemoryBarrier toTransfer = {};
-		toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		toTransfer.image = newImage.image;
-		toTransfer.subresourceRange = range;
-		toTransfer.srcAccessMask = 0;
-		toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		//barrier the image into the transfer-receive layout
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
-
-		VkBufferImageCopy copyRegion = {};
-		copyRegion.bufferOffset = 0;
-		copyRegion.bufferRowLength = 0;
-		copyRegion.bufferImageHeight = 0;
-		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		copyRegion.imageSubresource.mipLevel = 0;
-		copyRegion.imageSubresource.baseArrayLayer = 0;
-		copyRegion.imageSubresource.layerCount = 1;
-		copyRegion.imageExtent = { imageExtent.width, imageExtent.height, 1 };
-
-		//copy the buffer into the image
-		vkCmdCopyBufferToImage(commandBuffer, staging.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-		VkImageMemoryBarrier toReadable = toTransfer;
-		toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		//barrier the image into the shader readable layout
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toReadable);
-
-		device.endSingleTimeCommands(commandBuffer);
+		return device.getUploadBatcher().isComplete(uploadValue);
 	}
 
-	void Texture::createImageView(Format format)
+	void Texture::createImageView(VkFormat format)
 	{
-		VkImageViewCreateInfo imageinfo = VkUtil::imageViewCreateInfo((VkFormat)format, allocatedImage.image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		//Storage usage on an sRGB image only holds for its UNORM views, this one is just sampled
+		VkImageViewUsageCreateInfo usageInfo{};
+		usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VkImageViewCreateInfo imageinfo = VkUtil::imageViewCreateInfo(format, allocatedImage.image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+		imageinfo.pNext = &usageInfo;
 		vkCreateImageView(device.getDevice(), &imageinfo, nullptr, &imageView);
 	}
 
 	Texture::~Texture()
 	{
-		if (ownsImage)
+		if (pixels != nullptr)
+		{
+			freePixels(pixels);
+		}
+		if (ownsImage && uploadValue != NOT_UPLOADED)
 		{
 			vmaDestroyImage(device.getAllocator(), allocatedImage.image, allocatedImage.allocation);
 			vkDestroyImageView(device.getDevice(), imageView, nullptr);
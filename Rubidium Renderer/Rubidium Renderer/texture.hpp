@@ -1,6 +1,10 @@
 #pragma once
 
 #include "device.hpp"
+#include "ktx2_file.hpp"
+#include "thread_pool.hpp"
+
+#include <memory>
 
 namespace rub
 {
@@ -11,27 +15,60 @@ namespace rub
 		{
 			SRGB = VK_FORMAT_R8G8B8A8_SRGB,
 			LINEAR = VK_FORMAT_R8G8B8A8_UNORM,
+			//Stored as the smallest of HDR_STORAGE_FORMATS the device supports, full floats are only the fallback
 			HDR = VK_FORMAT_R32G32B32A32_SFLOAT
 		};
-		Texture(Device& device, const std::string& file, Format format);
+		//Smallest first. Halves keep 11 bits of precision per channel, the shared exponent keeps 9 relative to the brightest channel
+		static constexpr VkFormat HDR_STORAGE_FORMATS[] = { VK_FORMAT_E5B9G9R9_UFLOAT_PACK32, VK_FORMAT_R16G16B16A16_SFLOAT };
+		static constexpr uint64_t NOT_UPLOADED = UINT64_MAX;
+		//Fill the full mip chain at load, off only to compare against sampling the top level everywhere
+		static constexpr bool GENERATE_MIPS = true;
+
+		//EXR blocks are decoded on threadPool when one is given
+		Texture(Device& device, const std::string& file, Format format, ThreadPool* threadPool = nullptr);
+		//Creates an empty texture to be filled by decode() and upload(), which is how the asset manager loads in the background
+		Texture(Device& device, Format format);
 		Texture(Device& device, VkImageView imageView, int mipLevels);
 		~Texture();
 
 		AllocatedImage getImage() { return allocatedImage; }
 		VkImageView getImageView() { return imageView; }
 		int getMipLevels() { return mipLevels; }
+		//Reads the file into memory without touching the device, safe to call from a worker thread. A cooked .ktx2 beside the file is
+		//read instead when the device can sample block compressed formats and the cooked file is at least as new as its source
+		void decode(const std::string& file);
+		//Creates the image and records its upload, main thread only. A texture that failed to decode stays unready
+		void upload();
+		//True once the pixels are uploaded and the graphics queue owns the image, views of other images always are
+		bool isReady();
 	private:
 		Device& device;
 		AllocatedImage allocatedImage;
 		VkImageView imageView;
 
-		const int mipLevels = 1;
+		Format format = SRGB;
+		ThreadPool* threadPool = nullptr;
+		int mipLevels = 1;
 		bool ownsImage = true;
+		uint64_t uploadValue = NOT_UPLOADED;
+
+		//Decoded pixels waiting for upload() along with the function that releases them
+		void* pixels = nullptr;
+		void (*freePixels)(void*) = nullptr;
+		int width = 0;
+		int height = 0;
+		VkDeviceSize imageSize = 0;
+		//What the pixels were decoded to, which for HDR depends on the device
+		VkFormat imageFormat = VK_FORMAT_UNDEFINED;
+		//A cooked file replaces the pixels above, its levels are uploaded straight from the mapping
+		std::unique_ptr<Ktx2File> cooked;
 
-		bool createHDRImage(const std::string& file);
-		bool createSDRImage(const std::string& file, Format format);
-		void transferToGPU(const int width, const int height, Format format, AllocatedBuffer& stagingBuffer);
-		void transitionImageLayout(AllocatedBuffer staging, AllocatedImage newImage, Format format, VkExtent2D imageExtent);
-		void createImageView(Format format);
+		bool decodeKTX2(const std::string& file);
+		void decodeHDR(const std::string& file);
+		void decodeSDR(const std::string& file);
+		VkFormat selectHDRFormat(VkExtent2D extent);
+		void transferToGPU(const int width, const int height, VkFormat format, const void* pixels, VkDeviceSize imageSize);
+		void transferCookedToGPU();
+		void createImageView(VkFormat format);
 	};
 }
\ No newline at end of file
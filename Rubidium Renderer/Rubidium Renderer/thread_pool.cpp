@@ -0,0 +1,146 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace rub
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		threadCount = std::max(threadCount, 1u);
+
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	std::future<void> ThreadPool::enqueue(std::function<void()> task)
+	{
+		std::packaged_task<void()> packagedTask(std::move(task));
+		std::future<void> future = packagedTask.get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.push_back(std::move(packagedTask));
+		}
+		condition.notify_one();
+
+		return future;
+	}
+
+	void ThreadPool::parallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+	{
+		if (taskCount == 0)
+		{
+			return;
+		}
+
+		//Helpers share this through a pointer of their own. One that only starts after every task is done finds no index left,
+		//so it never touches task once this call has returned
+		struct Loop
+		{
+			const std::function<void(uint32_t)>* task;
+			uint32_t taskCount;
+			std::atomic<uint32_t> next{ 0 };
+			uint32_t remaining;
+			std::exception_ptr error;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+		loop->task = &task;
+		loop->taskCount = taskCount;
+		loop->remaining = taskCount;
+
+		auto run = [loop]()
+		{
+			for (uint32_t i = loop->next++; i < loop->taskCount; i = loop->next++)
+			{
+				std::exception_ptr error;
+				try
+				{
+					(*loop->task)(i);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(loop->mutex);
+				if (error && !loop->error)
+				{
+					loop->error = error;
+				}
+				if (--loop->remaining == 0)
+				{
+					loop->finished.notify_all();
+				}
+			}
+		};
+
+		//Helpers go to the front of the queue, and this thread takes indices as well, so the loop finishes even while
+		//every worker is busy with something long
+		uint32_t helperCount = std::min(taskCount - 1, getThreadCount());
+		if (helperCount > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				for (uint32_t i = 0; i < helperCount; i++)
+				{
+					tasks.emplace_front(run);
+				}
+			}
+			condition.notify_all();
+		}
+
+		run();
+
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		loop->finished.wait(lock, [&loop]() { return loop->remaining == 0; });
+		if (loop->error)
+		{
+			std::rethrow_exception(loop->error);
+		}
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		while (true)
+		{
+			std::packaged_task<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+				if (stopping && tasks.empty())
+				{
+					return;
+				}
+
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+
+			task();
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		condition.notify_all();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace rub
+{
+	class ThreadPool
+	{
+	public:
+		ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+		std::future<void> enqueue(std::function<void()> task);
+		//Runs task(0) ... task(taskCount - 1) on the workers and the calling thread, and blocks until all of them have finished.
+		//Its work goes ahead of anything already queued, so frame work never waits behind a long enqueued load.
+		//The first exception a task throws is rethrown once every task is done
+		void parallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::packaged_task<void()>> tasks;
+		std::mutex queueMutex;
+		std::condition_variable condition;
+		bool stopping = false;
+
+		void workerLoop();
+	};
+}
\ No newline at end of file
@@ -31,6 +31,12 @@ namespace rub
 		return finalMatrix;
 	}
 
+	glm::quat Transform::getOrientation() const
+	{
+		return glm::angleAxis(glm::radians(rotation.x), glm::vec3(1, 0, 0)) * glm::angleAxis(glm::radians(rotation.y), glm::vec3(0, 1, 0))
+			* glm::angleAxis(glm::radians(rotation.z), glm::vec3(0, 0, 1));
+	}
+
 	void Transform::rotate(glm::vec3 rotate)
 	{
 		glm::vec3 add = glm::vec3(rotation.x + rotate.x, rotation.y + rotate.y, rotation.z + rotate.z);
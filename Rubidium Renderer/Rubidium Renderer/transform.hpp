@@ -1,6 +1,7 @@
 #pragma once
 
 #include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
 
 namespace rub
 {
@@ -12,6 +13,8 @@ namespace rub
 		~Transform();
 
 		glm::mat4 getMatrix();
+		//The Euler rotation as a quaternion, matching the rotation part of getMatrix
+		glm::quat getOrientation() const;
 		void rotate(glm::vec3 rotation);
 		void move(glm::vec3 movement);
 
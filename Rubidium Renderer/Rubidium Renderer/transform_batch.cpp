@@ -0,0 +1,94 @@
+#include "transform_batch.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace rub
+{
+	//glm stores matrices as four contiguous columns, which is what the loads below rely on
+	static_assert(sizeof(glm::mat4) == sizeof(float) * 16);
+
+	void TransformBatch::multiply(const glm::mat4& viewProjection, const glm::mat4* models, glm::mat4* results, size_t count)
+	{
+		//Column j of the result is the view projection columns weighted by the components of model column j
+		const float* vp = &viewProjection[0][0];
+
+#if defined(__AVX__)
+		//Each view projection column is duplicated into both halves so two model columns are handled at once
+		__m256 column0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(vp));
+		__m256 column1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(vp + 4));
+		__m256 column2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(vp + 8));
+		__m256 column3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(vp + 12));
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* model = &models[i][0][0];
+			float* result = &results[i][0][0];
+			for (int j = 0; j < 16; j += 8)
+			{
+				__m256 columns = _mm256_loadu_ps(model + j);
+				__m256 x = _mm256_permute_ps(columns, 0x00);
+				__m256 y = _mm256_permute_ps(columns, 0x55);
+				__m256 z = _mm256_permute_ps(columns, 0xAA);
+				__m256 w = _mm256_permute_ps(columns, 0xFF);
+				__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(column0, x), _mm256_mul_ps(column1, y)),
+					_mm256_add_ps(_mm256_mul_ps(column2, z), _mm256_mul_ps(column3, w)));
+				_mm256_storeu_ps(result + j, sum);
+			}
+		}
+#else
+		__m128 column0 = _mm_loadu_ps(vp);
+		__m128 column1 = _mm_loadu_ps(vp + 4);
+		__m128 column2 = _mm_loadu_ps(vp + 8);
+		__m128 column3 = _mm_loadu_ps(vp + 12);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* model = &models[i][0][0];
+			float* result = &results[i][0][0];
+			for (int j = 0; j < 16; j += 4)
+			{
+				__m128 column = _mm_loadu_ps(model + j);
+				__m128 x = _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0));
+				__m128 y = _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1));
+				__m128 z = _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2));
+				__m128 w = _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3));
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, x), _mm_mul_ps(column1, y)),
+					_mm_add_ps(_mm_mul_ps(column2, z), _mm_mul_ps(column3, w)));
+				_mm_storeu_ps(result + j, sum);
+			}
+		}
+#endif
+	}
+
+	void TransformBatch::multiplyScalar(const glm::mat4& viewProjection, const glm::mat4* models, glm::mat4* results, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			results[i] = viewProjection * models[i];
+		}
+	}
+
+	void TransformBatch::multiplyParallel(ThreadPool& threadPool, const glm::mat4& viewProjection, const glm::mat4* models, glm::mat4* results, size_t count,
+		size_t chunkSize)
+	{
+		if (count <= chunkSize || threadPool.getThreadCount() <= 1)
+		{
+			multiply(viewProjection, models, results, count);
+			return;
+		}
+
+		uint32_t chunkCount = static_cast<uint32_t>((count + chunkSize - 1) / chunkSize);
+		threadPool.parallelFor(chunkCount, [&](uint32_t chunk)
+			{
+				size_t begin = chunk * chunkSize;
+				size_t end = std::min(begin + chunkSize, count);
+				multiply(viewProjection, models + begin, results + begin, end - begin);
+			});
+	}
+}
\ No newline at end of file
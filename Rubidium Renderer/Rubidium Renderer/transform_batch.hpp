@@ -0,0 +1,24 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rub
+{
+	//Multiplies one view projection matrix against many model matrices, the per object part of building MVPs
+	class TransformBatch
+	{
+	public:
+		//results[i] = viewProjection * models[i]. Two output columns per instruction with AVX, one with SSE
+		static void multiply(const glm::mat4& viewProjection, const glm::mat4* models, glm::mat4* results, size_t count);
+		//Reference version of multiply using glm
+		static void multiplyScalar(const glm::mat4& viewProjection, const glm::mat4* models, glm::mat4* results, size_t count);
+		//Splits the batch into chunks of chunkSize matrices and runs multiply on each one in the pool
+		static void multiplyParallel(ThreadPool& threadPool, const glm::mat4& viewProjection, const glm::mat4* models, glm::mat4* results, size_t count,
+			size_t chunkSize = CHUNK_SIZE);
+
+		//Below this many matrices splitting the work costs more than it saves
+		static constexpr size_t CHUNK_SIZE = 4096;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rub
+{
+	uint32_t TransformHierarchy::addNode(uint32_t parent, glm::vec3 position, glm::quat rotation)
+	{
+		uint32_t parentIndex = NO_PARENT;
+		uint32_t index = static_cast<uint32_t>(handles.size());
+		if (parent != NO_PARENT)
+		{
+			if (parent >= indices.size())
+			{
+				throw std::runtime_error("failed to find parent transform!");
+			}
+			parentIndex = indices[parent];
+
+			//A parent whose subtree runs to the end takes the child in place, anywhere else the order is fixed up later
+			if (!orderStale && parentIndex + subtreeSizes[parentIndex] == index)
+			{
+				for (uint32_t ancestor = parentIndex; ancestor != NO_PARENT; ancestor = parents[ancestor])
+				{
+					subtreeSizes[ancestor]++;
+				}
+			}
+			else
+			{
+				orderStale = true;
+			}
+		}
+
+		uint32_t handle = static_cast<uint32_t>(indices.size());
+		parents.push_back(parentIndex);
+		subtreeSizes.push_back(1);
+		localPositions.push_back(position);
+		localRotations.push_back(rotation);
+		worldMatrices.push_back(glm::mat4{ 1.0f });
+		dirty.push_back(0);
+		handles.push_back(handle);
+		indices.push_back(index);
+
+		markDirty(index);
+		return handle;
+	}
+
+	void TransformHierarchy::setLocalPosition(uint32_t node, glm::vec3 position)
+	{
+		uint32_t index = indices[node];
+		localPositions[index] = position;
+		markDirty(index);
+	}
+
+	void TransformHierarchy::setLocalRotation(uint32_t node, glm::quat rotation)
+	{
+		uint32_t index = indices[node];
+		localRotations[index] = rotation;
+		markDirty(index);
+	}
+
+	void TransformHierarchy::rotate(uint32_t node, glm::quat rotation)
+	{
+		uint32_t index = indices[node];
+		localRotations[index] = glm::normalize(localRotations[index] * rotation);
+		markDirty(index);
+	}
+
+	void TransformHierarchy::markDirty(uint32_t index)
+	{
+		if (!dirty[index])
+		{
+			dirty[index] = 1;
+			dirtyNodes.push_back(index);
+		}
+	}
+
+	void TransformHierarchy::restoreDepthFirstOrder()
+	{
+		uint32_t count = static_cast<uint32_t>(handles.size());
+
+		//Every node was appended after its parent, so walking backwards finishes a subtree before adding it to its parent's
+		std::fill(subtreeSizes.begin(), subtreeSizes.end(), 1);
+		for (uint32_t i = count; i-- > 0;)
+		{
+			if (parents[i] != NO_PARENT)
+			{
+				subtreeSizes[parents[i]] += subtreeSizes[i];
+			}
+		}
+
+		//Walking forwards, each node takes the next free slot in its parent's range and reserves its own subtree's worth
+		std::vector<uint32_t> newIndices(count);
+		std::vector<uint32_t> nextChild(count);
+		uint32_t nextRoot = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (parents[i] == NO_PARENT)
+			{
+				newIndices[i] = nextRoot;
+				nextRoot += subtreeSizes[i];
+			}
+			else
+			{
+				newIndices[i] = nextChild[parents[i]];
+				nextChild[parents[i]] += subtreeSizes[i];
+			}
+			nextChild[i] = newIndices[i] + 1;
+		}
+
+		std::vector<uint32_t> newParents(count);
+		std::vector<uint32_t> newSubtreeSizes(count);
+		std::vector<glm::vec3> newPositions(count);
+		std::vector<glm::quat> newRotations(count);
+		std::vector<glm::mat4> newWorldMatrices(count);
+		std::vector<uint8_t> newDirty(count);
+		std::vector<uint32_t> newHandles(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t index = newIndices[i];
+			newParents[index] = parents[i] == NO_PARENT ? NO_PARENT : newIndices[parents[i]];
+			newSubtreeSizes[index] = subtreeSizes[i];
+			newPositions[index] = localPositions[i];
+			newRotations[index] = localRotations[i];
+			newWorldMatrices[index] = worldMatrices[i];
+			newDirty[index] = dirty[i];
+			newHandles[index] = handles[i];
+			indices[handles[i]] = index;
+		}
+		parents = std::move(newParents);
+		subtreeSizes = std::move(newSubtreeSizes);
+		localPositions = std::move(newPositions);
+		localRotations = std::move(newRotations);
+		worldMatrices = std::move(newWorldMatrices);
+		dirty = std::move(newDirty);
+		handles = std::move(newHandles);
+
+		for (uint32_t& dirtyIndex : dirtyNodes)
+		{
+			dirtyIndex = newIndices[dirtyIndex];
+		}
+		orderStale = false;
+	}
+
+	void TransformHierarchy::update(std::vector<uint32_t>& changedNodes)
+	{
+		if (orderStale)
+		{
+			restoreDepthFirstOrder();
+		}
+
+		if (dirtyNodes.empty())
+		{
+			return;
+		}
+
+		//Sorted, a dirty node's whole subtree is recomputed before any node after it, and dirty descendants inside
+		//that range are skipped since their parent chain has just been brought up to date
+		std::sort(dirtyNodes.begin(), dirtyNodes.end());
+
+		uint32_t coveredEnd = 0;
+		for (uint32_t first : dirtyNodes)
+		{
+			if (first < coveredEnd)
+			{
+				continue;
+			}
+
+			uint32_t end = first + subtreeSizes[first];
+			for (uint32_t i = first; i < end; i++)
+			{
+				//Quaternion to matrix is a handful of multiplies, no trig
+				glm::mat4 local = glm::mat4_cast(localRotations[i]);
+				local[3] = glm::vec4(localPositions[i], 1.0f);
+
+				worldMatrices[i] = parents[i] == NO_PARENT ? local : worldMatrices[parents[i]] * local;
+				dirty[i] = 0;
+				changedNodes.push_back(handles[i]);
+			}
+			coveredEnd = end;
+		}
+
+		dirtyNodes.clear();
+	}
+}
\ No newline at end of file
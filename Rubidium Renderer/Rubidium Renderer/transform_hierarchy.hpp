@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace rub
+{
+	//Parent and child transforms stored depth first, so every parent comes before its children and a node's
+	//descendants are the nodes directly after it. Nodes are referred to by handles that stay valid as nodes are added
+	class TransformHierarchy
+	{
+	public:
+		static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+		//Roots, and children added straight after their parent's last descendant as a depth first load does, are appended in
+		//constant time. Any other child is appended out of order and the depth first order is rebuilt once, in linear time, by the next update
+		uint32_t addNode(uint32_t parent, glm::vec3 position, glm::quat rotation);
+		void setLocalPosition(uint32_t node, glm::vec3 position);
+		void setLocalRotation(uint32_t node, glm::quat rotation);
+		//Applies rotation after the node's current local rotation
+		void rotate(uint32_t node, glm::quat rotation);
+		glm::vec3 getLocalPosition(uint32_t node) const { return localPositions[indices[node]]; }
+		glm::quat getLocalRotation(uint32_t node) const { return localRotations[indices[node]]; }
+		//Only current after update
+		const glm::mat4& getWorldMatrix(uint32_t node) const { return worldMatrices[indices[node]]; }
+		size_t size() const { return handles.size(); }
+
+		//Recomputes the world matrices of dirty nodes and their descendants in one depth first pass, so the cost
+		//follows what moved rather than the size of the hierarchy. Handles of every recomputed node are appended to changedNodes
+		void update(std::vector<uint32_t>& changedNodes);
+
+	private:
+		//Indexed by depth first position
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> subtreeSizes; //The node plus all of its descendants
+		std::vector<glm::vec3> localPositions;
+		std::vector<glm::quat> localRotations;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<uint8_t> dirty;
+		std::vector<uint32_t> handles;
+
+		//Indexed by handle
+		std::vector<uint32_t> indices;
+
+		//Depth first positions of nodes marked since the last update, each one only listed once
+		std::vector<uint32_t> dirtyNodes;
+		//Set when a child was appended away from its parent's subtree, parents still come before their children
+		bool orderStale = false;
+
+		void markDirty(uint32_t index);
+		void restoreDepthFirstOrder();
+	};
+}
\ No newline at end of file
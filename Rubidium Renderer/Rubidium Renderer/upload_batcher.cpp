@@ -0,0 +1,505 @@
+#include "upload_batcher.hpp"
+#include "vk_util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace rub
+{
+	//Whichever stage ends up reading an uploaded buffer first
+	static constexpr VkAccessFlags BUFFER_READ_ACCESS = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+		VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	static constexpr VkPipelineStageFlags READ_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	UploadBatcher::UploadBatcher(Device& device, VkDeviceSize stagingSize) : device{ device }, stagingSize{ stagingSize }
+	{
+		//Image copies need offsets aligned to the texel size, 16 bytes covers every format we upload
+		stagingAlignment = std::max<VkDeviceSize>(16, device.getDeviceProperties().limits.optimalBufferCopyOffsetAlignment);
+
+		QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
+		graphicsFamily = indices.graphicsFamily.value();
+		transferFamily = indices.transferFamily.value_or(graphicsFamily);
+		dedicatedTransfer = transferFamily != graphicsFamily;
+
+		transferPool = createCommandPool(transferFamily);
+		if (dedicatedTransfer)
+		{
+			graphicsPool = createCommandPool(graphicsFamily);
+		}
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(device.getDevice(), &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+		}
+
+		void* mappedData;
+		device.createMappedBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer, &mappedData);
+		stagingData = static_cast<char*>(mappedData);
+	}
+
+	VkCommandPool UploadBatcher::createCommandPool(uint32_t queueFamily)
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		VkCommandPool commandPool;
+		if (vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+		return commandPool;
+	}
+
+	void UploadBatcher::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		VkDeviceSize srcOffset;
+		VkBuffer srcBuffer = stage(data, size, srcOffset);
+		Batch& batch = beginBatch();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(batch.commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+		//Only ranges changing queue family need a barrier of their own, otherwise one memory barrier covers the whole batch
+		if (dedicatedTransfer)
+		{
+			VkBufferMemoryBarrier release{};
+			release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			release.dstAccessMask = 0;
+			release.srcQueueFamilyIndex = transferFamily;
+			release.dstQueueFamilyIndex = graphicsFamily;
+			release.buffer = dstBuffer;
+			release.offset = dstOffset;
+			release.size = size;
+			batch.bufferBarriers.push_back(release);
+		}
+		batch.hasBufferCopies = true;
+	}
+
+	void UploadBatcher::uploadImage(VkImage image, VkFormat format, VkExtent2D extent, uint32_t mipLevels, const void* data, VkDeviceSize size)
+	{
+		VkDeviceSize srcOffset;
+		VkBuffer srcBuffer = stage(data, size, srcOffset);
+		Batch& batch = beginBatch();
+
+		//Only the first level is transferred, the rest of the chain is still undefined and gets written on the graphics queue
+		recordImageCopy(batch, image, srcBuffer, srcOffset, { { 0, extent } });
+
+		if (mipLevels > 1)
+		{
+			batch.mipChains.push_back({ image, format, extent, mipLevels });
+		}
+	}
+
+	void UploadBatcher::uploadImageLevels(VkImage image, const void* data, VkDeviceSize size, const std::vector<ImageLevel>& levels)
+	{
+		VkDeviceSize srcOffset;
+		VkBuffer srcBuffer = stage(data, size, srcOffset);
+		Batch& batch = beginBatch();
+
+		recordImageCopy(batch, image, srcBuffer, srcOffset, levels);
+	}
+
+	void UploadBatcher::recordImageCopy(Batch& batch, VkImage image, VkBuffer srcBuffer, VkDeviceSize srcOffset, const std::vector<ImageLevel>& levels)
+	{
+		VkImageSubresourceRange range;
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.baseMipLevel = 0;
+		range.levelCount = static_cast<uint32_t>(levels.size());
+		range.baseArrayLayer = 0;
+		range.layerCount = 1;
+
+		VkImageMemoryBarrier toTransfer = {};
+		toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.image = image;
+		toTransfer.subresourceRange = range;
+		toTransfer.srcAccessMask = 0;
+		toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		//barrier the image into the transfer-receive layout
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+		std::vector<VkBufferImageCopy> copyRegions(levels.size());
+		for (uint32_t level = 0; level < levels.size(); level++)
+		{
+			VkBufferImageCopy& copyRegion = copyRegions[level];
+			copyRegion.bufferOffset = srcOffset + levels[level].offset;
+			copyRegion.bufferRowLength = 0;
+			copyRegion.bufferImageHeight = 0;
+			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyRegion.imageSubresource.mipLevel = level;
+			copyRegion.imageSubresource.baseArrayLayer = 0;
+			copyRegion.imageSubresource.layerCount = 1;
+			copyRegion.imageOffset = { 0, 0, 0 };
+			copyRegion.imageExtent = { levels[level].extent.width, levels[level].extent.height, 1 };
+		}
+
+		//copy the buffer into the image
+		vkCmdCopyBufferToImage(batch.commandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+		//The shader readable transition is recorded with the rest at the end of the batch, as part of the release if the family changes
+		VkImageMemoryBarrier toReadable = toTransfer;
+		toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toReadable.dstAccessMask = dedicatedTransfer ? 0 : VK_ACCESS_SHADER_READ_BIT;
+		if (dedicatedTransfer)
+		{
+			toReadable.srcQueueFamilyIndex = transferFamily;
+			toReadable.dstQueueFamilyIndex = graphicsFamily;
+		}
+		batch.imageBarriers.push_back(toReadable);
+	}
+
+	void UploadBatcher::flush()
+	{
+		if (!isRecording)
+		{
+			return;
+		}
+
+		recordBarriers(recording);
+		submit(recording);
+
+		inFlight.push_back(std::move(recording));
+		recording = Batch{};
+		isRecording = false;
+		submitCount++;
+	}
+
+	void UploadBatcher::recordBarriers(Batch& batch)
+	{
+		if (!dedicatedTransfer)
+		{
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = BUFFER_READ_ACCESS;
+			uint32_t memoryBarrierCount = batch.hasBufferCopies ? 1 : 0;
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, READ_STAGES, 0, memoryBarrierCount, &barrier, 0, nullptr,
+				static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+			generateMips(batch.commandBuffer, batch);
+			vkEndCommandBuffer(batch.commandBuffer);
+			return;
+		}
+
+		//Release on the transfer queue, nothing there reads the resources afterwards so the destination scope is empty
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+			static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(), static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+		vkEndCommandBuffer(batch.commandBuffer);
+
+		//The acquire repeats the release with the access masks moved to the destination side, layout transition included
+		for (VkBufferMemoryBarrier& barrier : batch.bufferBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = BUFFER_READ_ACCESS;
+		}
+		for (VkImageMemoryBarrier& barrier : batch.imageBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo);
+		vkCmdPipelineBarrier(batch.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, READ_STAGES, 0, 0, nullptr,
+			static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(), static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+		//Transfer queues can't run compute, so the chains are filled here once the graphics queue owns the first levels
+		generateMips(batch.acquireCommandBuffer, batch);
+		vkEndCommandBuffer(batch.acquireCommandBuffer);
+	}
+
+	void UploadBatcher::generateMips(VkCommandBuffer commandBuffer, Batch& batch)
+	{
+		//The barrier before this already made every first level readable by compute
+		for (const MipChain& chain : batch.mipChains)
+		{
+			//Formats or sizes the downsampler can't take are blitted a level at a time instead
+			if (!MipDownsampler::isSupported(device, chain.format, chain.extent))
+			{
+				VkUtil::generateMipMaps(commandBuffer, chain.image, chain.extent, chain.mipLevels, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+				continue;
+			}
+
+			MipDownsampler::Resources resources;
+			device.getMipDownsampler().record(commandBuffer, chain.image, chain.format, chain.extent, chain.mipLevels, 1,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, resources);
+			batch.downsamples.push_back(std::move(resources));
+		}
+	}
+
+	void UploadBatcher::submit(Batch& batch)
+	{
+		uint64_t copiedValue = ++timelineValue;
+
+		VkTimelineSemaphoreSubmitInfo copyTimelineInfo{};
+		copyTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		copyTimelineInfo.signalSemaphoreValueCount = 1;
+		copyTimelineInfo.pSignalSemaphoreValues = &copiedValue;
+
+		VkSubmitInfo copySubmit{};
+		copySubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		copySubmit.pNext = &copyTimelineInfo;
+		copySubmit.commandBufferCount = 1;
+		copySubmit.pCommandBuffers = &batch.commandBuffer;
+		copySubmit.signalSemaphoreCount = 1;
+		copySubmit.pSignalSemaphores = &timeline;
+		if (vkQueueSubmit(device.getTransferQueue(), 1, &copySubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+		batch.timelineValue = copiedValue;
+
+		if (!dedicatedTransfer)
+		{
+			return;
+		}
+
+		//The graphics queue waits for the copies before acquiring, and only later submissions on it see the resources
+		uint64_t acquiredValue = ++timelineValue;
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkTimelineSemaphoreSubmitInfo acquireTimelineInfo{};
+		acquireTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		acquireTimelineInfo.waitSemaphoreValueCount = 1;
+		acquireTimelineInfo.pWaitSemaphoreValues = &copiedValue;
+		acquireTimelineInfo.signalSemaphoreValueCount = 1;
+		acquireTimelineInfo.pSignalSemaphoreValues = &acquiredValue;
+
+		VkSubmitInfo acquireSubmit{};
+		acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmit.pNext = &acquireTimelineInfo;
+		acquireSubmit.waitSemaphoreCount = 1;
+		acquireSubmit.pWaitSemaphores = &timeline;
+		acquireSubmit.pWaitDstStageMask = &waitStage;
+		acquireSubmit.commandBufferCount = 1;
+		acquireSubmit.pCommandBuffers = &batch.acquireCommandBuffer;
+		acquireSubmit.signalSemaphoreCount = 1;
+		acquireSubmit.pSignalSemaphores = &timeline;
+		if (vkQueueSubmit(device.getGraphicsQueue(), 1, &acquireSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload acquire!");
+		}
+		batch.timelineValue = acquiredValue;
+	}
+
+	void UploadBatcher::waitIdle()
+	{
+		flush();
+		while (!inFlight.empty())
+		{
+			retireOldest(true);
+		}
+	}
+
+	uint64_t UploadBatcher::getUploadValue() const
+	{
+		//The recording batch takes the next one or two values when it's submitted
+		if (isRecording)
+		{
+			return timelineValue + (dedicatedTransfer ? 2 : 1);
+		}
+		return timelineValue;
+	}
+
+	bool UploadBatcher::isComplete(uint64_t uploadValue)
+	{
+		if (uploadValue > completedValue)
+		{
+			vkGetSemaphoreCounterValue(device.getDevice(), timeline, &completedValue);
+		}
+		return uploadValue <= completedValue;
+	}
+
+	UploadBatcher::Batch& UploadBatcher::beginBatch()
+	{
+		if (isRecording)
+		{
+			return recording;
+		}
+
+		//Give back whatever already finished while we're here, it costs one counter query
+		while (!inFlight.empty() && retireOldest(false));
+
+		if (freeBatches.empty())
+		{
+			Batch batch{};
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = transferPool;
+			allocInfo.commandBufferCount = 1;
+			vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &batch.commandBuffer);
+
+			if (dedicatedTransfer)
+			{
+				allocInfo.commandPool = graphicsPool;
+				vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &batch.acquireCommandBuffer);
+			}
+
+			freeBatches.push_back(std::move(batch));
+		}
+
+		recording = std::move(freeBatches.back());
+		freeBatches.pop_back();
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(recording.commandBuffer, &beginInfo);
+
+		isRecording = true;
+		return recording;
+	}
+
+	VkBuffer UploadBatcher::stage(const void* data, VkDeviceSize size, VkDeviceSize& srcOffset)
+	{
+		uploadedBytes += size;
+
+		if (size > stagingSize)
+		{
+			AllocatedBuffer dedicatedBuffer;
+			void* mappedData;
+			device.createMappedBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, dedicatedBuffer, &mappedData);
+			memcpy(mappedData, data, static_cast<size_t>(size));
+
+			beginBatch().dedicatedBuffers.push_back(dedicatedBuffer);
+			srcOffset = 0;
+			return dedicatedBuffer.buffer;
+		}
+
+		VkDeviceSize start = (head + stagingAlignment - 1) & ~(stagingAlignment - 1);
+		VkDeviceSize consumed;
+		while (!reserve(size, start, consumed))
+		{
+			//The ring is full, so submit what's recorded and wait for the oldest batch to give its space back
+			flush();
+			if (inFlight.empty())
+			{
+				throw std::runtime_error("failed to stage upload, staging ring is full!");
+			}
+			retireOldest(true);
+			start = (head + stagingAlignment - 1) & ~(stagingAlignment - 1);
+		}
+
+		memcpy(stagingData + start, data, static_cast<size_t>(size));
+		beginBatch().stagingUsed += consumed;
+
+		srcOffset = start;
+		return stagingBuffer.buffer;
+	}
+
+	bool UploadBatcher::reserve(VkDeviceSize size, VkDeviceSize& start, VkDeviceSize& consumed)
+	{
+		//Nothing is in flight, so the next upload might as well start at the beginning instead of wrapping
+		if (used == 0)
+		{
+			head = 0;
+			start = 0;
+		}
+
+		if (start + size <= stagingSize)
+		{
+			consumed = start - head + size;
+		}
+		else
+		{
+			//Skip the tail of the ring, it goes back to being free along with this batch
+			consumed = stagingSize - head + size;
+			start = 0;
+		}
+
+		if (used + consumed > stagingSize)
+		{
+			return false;
+		}
+
+		head = start + size;
+		used += consumed;
+		return true;
+	}
+
+	bool UploadBatcher::retireOldest(bool wait)
+	{
+		Batch& batch = inFlight.front();
+		if (!isComplete(batch.timelineValue))
+		{
+			if (!wait)
+			{
+				return false;
+			}
+
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &batch.timelineValue;
+			vkWaitSemaphores(device.getDevice(), &waitInfo, UINT64_MAX);
+			completedValue = batch.timelineValue;
+		}
+
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		if (batch.acquireCommandBuffer != VK_NULL_HANDLE)
+		{
+			vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+		}
+		for (AllocatedBuffer& dedicatedBuffer : batch.dedicatedBuffers)
+		{
+			vmaDestroyBuffer(device.getAllocator(), dedicatedBuffer.buffer, dedicatedBuffer.allocation);
+		}
+		batch.dedicatedBuffers.clear();
+		batch.bufferBarriers.clear();
+		batch.imageBarriers.clear();
+		batch.mipChains.clear();
+		for (MipDownsampler::Resources& resources : batch.downsamples)
+		{
+			device.getMipDownsampler().release(resources);
+		}
+		batch.downsamples.clear();
+		batch.hasBufferCopies = false;
+
+		//Batches finish in submission order, so the space they give back is always the oldest part of the ring
+		used -= batch.stagingUsed;
+		batch.stagingUsed = 0;
+
+		freeBatches.push_back(std::move(batch));
+		inFlight.pop_front();
+		return true;
+	}
+
+	UploadBatcher::~UploadBatcher()
+	{
+		waitIdle();
+
+		vkDestroySemaphore(device.getDevice(), timeline, nullptr);
+		vkDestroyCommandPool(device.getDevice(), transferPool, nullptr);
+		if (graphicsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(device.getDevice(), graphicsPool, nullptr);
+		}
+		vmaDestroyBuffer(device.getAllocator(), stagingBuffer.buffer, stagingBuffer.allocation);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "device.hpp"
+#include "mip_downsampler.hpp"
+
+#include <deque>
+#include <vector>
+
+namespace rub
+{
+	//Collects buffer and image uploads from any number of resources into one command buffer, staged through a persistently mapped
+	//ring buffer. A batch is submitted when flushed or when the ring runs out of space, and its part of the ring is handed out
+	//again once it completes, so loading only stalls when the ring wraps onto a batch still in flight.
+	//When the GPU has a dedicated transfer family the copies run on that queue and release ownership to the graphics family,
+	//which acquires it in a small submit of its own. Every batch signals a timeline semaphore, so a resource knows it is resident
+	//once the counter passes the value returned by getUploadValue() after its uploads
+	class UploadBatcher
+	{
+	public:
+		static constexpr VkDeviceSize STAGING_BUFFER_SIZE = 64ull << 20;
+		//What a format needs for its mip chain to be blitted when the mip downsampler can't fill it
+		static constexpr VkFormatFeatureFlags BLIT_MIP_FEATURES = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | 
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		//Where a mip level starts in the data handed to uploadImageLevels() and how large it is
+		struct ImageLevel
+		{
+			VkDeviceSize offset;
+			VkExtent2D extent;
+		};
+
+		UploadBatcher(Device& device, VkDeviceSize stagingSize = STAGING_BUFFER_SIZE);
+		~UploadBatcher();
+
+		UploadBatcher(const UploadBatcher&) = delete;
+		UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+		//Copies size bytes of data into dstBuffer at dstOffset, visible to vertex input, shaders and indirect reads after the batch
+		void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		//Fills the first mip level of a single layer image and leaves every level in shader read only layout. The other levels are
+		//generated on the graphics queue by the mip downsampler, or by linear blits when it doesn't support the image, so the image
+		//has to meet the requirements of whichever one applies when mipLevels is above one
+		void uploadImage(VkImage image, VkFormat format, VkExtent2D extent, uint32_t mipLevels, const void* data, VkDeviceSize size);
+		//Fills every level of a single layer image from one block of data, for chains cooked offline such as block compressed textures.
+		//Each offset has to keep the format's texel block alignment, and the levels are left in shader read only layout
+		void uploadImageLevels(VkImage image, const void* data, VkDeviceSize size, const std::vector<ImageLevel>& levels);
+
+		//Submits everything recorded so far without waiting on it
+		void flush();
+		//Submits everything recorded so far and waits for all batches in flight
+		void waitIdle();
+
+		//Timeline value the most recently recorded upload is complete at, including the graphics family acquiring it
+		uint64_t getUploadValue() const;
+		bool isComplete(uint64_t uploadValue);
+
+		bool hasDedicatedTransferQueue() const { return dedicatedTransfer; }
+		uint32_t getSubmitCount() const { return submitCount; }
+		VkDeviceSize getUploadedBytes() const { return uploadedBytes; }
+
+	private:
+		struct MipChain
+		{
+			VkImage image;
+			VkFormat format;
+			VkExtent2D extent;
+			uint32_t mipLevels;
+		};
+
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer;
+			//Acquires ownership on the graphics queue, only used with a dedicated transfer family
+			VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+			uint64_t timelineValue = 0;
+			//Ring space taken by this batch, alignment and wrap padding included
+			VkDeviceSize stagingUsed = 0;
+			//Uploads larger than the whole ring get a staging buffer of their own that lives as long as the batch
+			std::vector<AllocatedBuffer> dedicatedBuffers;
+			//Recorded at the end of the batch, either the final transitions or the ownership releases
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			//Images to downsample once the graphics queue owns their first level, and what their dispatches use
+			std::vector<MipChain> mipChains;
+			std::vector<MipDownsampler::Resources> downsamples;
+			bool hasBufferCopies = false;
+		};
+
+		Device& device;
+		uint32_t graphicsFamily;
+		uint32_t transferFamily;
+		bool dedicatedTransfer;
+		VkCommandPool transferPool;
+		VkCommandPool graphicsPool = VK_NULL_HANDLE;
+
+		VkSemaphore timeline;
+		uint64_t timelineValue = 0;
+		uint64_t completedValue = 0;
+
+		AllocatedBuffer stagingBuffer;
+		char* stagingData;
+		VkDeviceSize stagingSize;
+		VkDeviceSize stagingAlignment;
+		VkDeviceSize head = 0;
+		VkDeviceSize used = 0;
+
+		Batch recording{};
+		bool isRecording = false;
+		std::deque<Batch> inFlight;
+		std::vector<Batch> freeBatches;
+
+		uint32_t submitCount = 0;
+		VkDeviceSize uploadedBytes = 0;
+
+		Batch& beginBatch();
+		VkBuffer stage(const void* data, VkDeviceSize size, VkDeviceSize& srcOffset);
+		//start comes in as the aligned head and may be moved to the front of the ring, consumed includes the bytes skipped to get there
+		bool reserve(VkDeviceSize size, VkDeviceSize& start, VkDeviceSize& consumed);
+		void recordImageCopy(Batch& batch, VkImage image, VkBuffer srcBuffer, VkDeviceSize srcOffset, const std::vector<ImageLevel>& levels);
+		void recordBarriers(Batch& batch);
+		void generateMips(VkCommandBuffer commandBuffer, Batch& batch);
+		void submit(Batch& batch);
+		bool retireOldest(bool wait);
+		VkCommandPool createCommandPool(uint32_t queueFamily);
+	};
+}
\ No newline at end of file
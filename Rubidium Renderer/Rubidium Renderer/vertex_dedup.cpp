@@ -0,0 +1,41 @@
+#include "vertex_dedup.hpp"
+
+#include "hash.hpp"
+
+namespace rub
+{
+	VertexDedup::VertexDedup(size_t maxKeys)
+	{
+		//At most half full, which keeps probes short without rehashing
+		size_t capacity = 16;
+		while (capacity < maxKeys * 2)
+		{
+			capacity *= 2;
+		}
+		entries.resize(capacity, Entry{ {}, EMPTY });
+		mask = capacity - 1;
+	}
+
+	uint32_t VertexDedup::insert(const Key& key, bool& isNew)
+	{
+		uint64_t packed = static_cast<uint32_t>(key.position) | (static_cast<uint64_t>(static_cast<uint32_t>(key.normal)) << 32);
+		uint64_t hash = Hash::mix(packed ^ Hash::mix(static_cast<uint32_t>(key.texCoord) + 0x9e3779b97f4a7c15ull));
+
+		for (size_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			Entry& entry = entries[i];
+			if (entry.slot == EMPTY)
+			{
+				entry.key = key;
+				entry.slot = count++;
+				isNew = true;
+				return entry.slot;
+			}
+			if (entry.key.position == key.position && entry.key.normal == key.normal && entry.key.texCoord == key.texCoord)
+			{
+				isNew = false;
+				return entry.slot;
+			}
+		}
+	}
+}
\ No newline at end of file
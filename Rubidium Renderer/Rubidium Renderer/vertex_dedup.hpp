@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace rub
+{
+	//Assigns one vertex slot per unique OBJ index tuple. Keys live in a flat open addressing table sized up front,
+	//so a lookup is one hash and a short linear probe through contiguous memory
+	class VertexDedup
+	{
+	public:
+		struct Key
+		{
+			int32_t position;
+			int32_t normal;
+			int32_t texCoord;
+		};
+
+		//maxKeys must be at least the number of keys that will be inserted, normally the index count
+		explicit VertexDedup(size_t maxKeys);
+
+		//Returns the key's slot. New keys get the next slot and set isNew, so the caller knows to emit a vertex
+		uint32_t insert(const Key& key, bool& isNew);
+		uint32_t size() const { return count; }
+
+	private:
+		struct Entry
+		{
+			Key key;
+			uint32_t slot;
+		};
+
+		static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+		std::vector<Entry> entries;
+		size_t mask;
+		uint32_t count = 0;
+	};
+}
\ No newline at end of file
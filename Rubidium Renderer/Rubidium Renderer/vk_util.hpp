@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 
 namespace rub
@@ -46,17 +48,6 @@ namespace rub
 			return alignedSize;
 		}
 
-		static void copyBuffer(Device& device, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-		{
-			VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-			VkBufferCopy copyRegion{};
-			copyRegion.size = size;
-			vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-			device.endSingleTimeCommands(commandBuffer);
-		}
-
 		static VkImageCreateInfo imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent2D extent, int mipLevels)
 		{
 			VkImageCreateInfo info{};
@@ -226,69 +217,55 @@ namespace rub
 			output = newImage;
 		}
 
-		static void generateMipMaps(VkCommandBuffer commandBuffer, VkImage oldImage, VkImage newImage, int width, int height, int layerCount)
+		//Fills levels 1 and up of every layer in place, blitting each level from the one above it with linear filtering, so the format
+		//needs linear blit support and the image transfer source and destination usage. Level 0 is moved from baseLayout once
+		//srcStage and srcAccess are done with it. Every level ends in shader read only layout
+		static void generateMipMaps(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, int mipLevels, int layerCount, 
+			VkImageLayout baseLayout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
 		{
-			const int mipLevels = calculateMipLevels(width, height);
-
-			VkImageMemoryBarrier oldImageBarrier{};
-			oldImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			oldImageBarrier.image = oldImage;
-			oldImageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			oldImageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			oldImageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			oldImageBarrier.subresourceRange.baseArrayLayer = 0;
-			oldImageBarrier.subresourceRange.layerCount = layerCount;
-			oldImageBarrier.subresourceRange.levelCount = 1;
-
-			//Transition oldImage from current layout to transfer source
-			oldImageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-			oldImageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			oldImageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-			oldImageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &oldImageBarrier);
-
-			//Transition newImage from undefined layout to transfer destination
-			VkImageMemoryBarrier newImageBarrier = oldImageBarrier;
-			newImageBarrier.image = newImage;
-			newImageBarrier.subresourceRange.levelCount = mipLevels;
-			newImageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			newImageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			newImageBarrier.srcAccessMask = VK_ACCESS_NONE_KHR;
-			newImageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &newImageBarrier);
-
-			//Generate mip maps
-			int32_t mipWidth = width;
-			int32_t mipHeight = height;
-			for (int i = 0; i < mipLevels; i++)
+			//Level 0 becomes the first source, the rest of the chain is still undefined
+			std::array<VkImageMemoryBarrier, 2> toTransfer;
+			toTransfer[0] = imageMemoryBarrier(image, VK_IMAGE_ASPECT_COLOR_BIT, 1, layerCount);
+			toTransfer[0].oldLayout = baseLayout;
+			toTransfer[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			toTransfer[0].srcAccessMask = srcAccess;
+			toTransfer[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			toTransfer[1] = imageMemoryBarrier(image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels - 1, layerCount);
+			toTransfer[1].subresourceRange.baseMipLevel = 1;
+			toTransfer[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			toTransfer[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			toTransfer[1].srcAccessMask = 0;
+			toTransfer[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 
+				static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+
+			//Each level only reads the one above it, a quarter of what the level before read
+			for (int level = 1; level < mipLevels; level++)
 			{
 				VkImageBlit blit{};
-				blit.srcOffsets[0] = { 0, 0, 0 };
-				blit.srcOffsets[1] = { width, height, 1 };
-				blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				blit.srcSubresource.mipLevel = 0;
-				blit.srcSubresource.baseArrayLayer = 0;
-				blit.srcSubresource.layerCount = 6;
-				blit.dstOffsets[0] = { 0, 0, 0 };
-				blit.dstOffsets[1] = { mipWidth, mipHeight, 1 };
-				blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				blit.dstSubresource.mipLevel = i;
-				blit.dstSubresource.baseArrayLayer = 0;
-				blit.dstSubresource.layerCount = 6;
-
-				vkCmdBlitImage(commandBuffer, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
-
-				if (mipWidth > 1) mipWidth /= 2;
-				if (mipHeight > 1) mipHeight /= 2;
+				blit.srcOffsets[1] = { std::max(1, static_cast<int32_t>(extent.width >> (level - 1))), std::max(1, static_cast<int32_t>(extent.height >> (level - 1))), 1 };
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, static_cast<uint32_t>(level - 1), 0, static_cast<uint32_t>(layerCount) };
+				blit.dstOffsets[1] = { std::max(1, static_cast<int32_t>(extent.width >> level)), std::max(1, static_cast<int32_t>(extent.height >> level)), 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, static_cast<uint32_t>(level), 0, static_cast<uint32_t>(layerCount) };
+				vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+				VkImageMemoryBarrier toSource = imageMemoryBarrier(image, VK_IMAGE_ASPECT_COLOR_BIT, 1, layerCount);
+				toSource.subresourceRange.baseMipLevel = level;
+				toSource.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				toSource.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				toSource.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				toSource.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSource);
 			}
 
-			//Transition from transfer source to shader read only
-			VkImageMemoryBarrier toShaderBarrier = newImageBarrier;
-			toShaderBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			toShaderBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			toShaderBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			toShaderBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShaderBarrier);
+			//Every level is a transfer source by now, the last one's writes made available by the barrier above
+			VkImageMemoryBarrier toReadable = imageMemoryBarrier(image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, layerCount);
+			toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			toReadable.srcAccessMask = 0;
+			toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 
+				0, nullptr, 0, nullptr, 1, &toReadable);
 		}
 	};
 }
\ No newline at end of file
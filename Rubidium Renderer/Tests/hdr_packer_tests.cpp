@@ -0,0 +1,210 @@
+#include "tests.hpp"
+#include "../Rubidium Renderer/hdr_packer.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace rub::tests
+{
+	static double halfToDouble(uint16_t half)
+	{
+		int exponent = (half >> 10) & 0x1F;
+		int mantissa = half & 0x3FF;
+		double value = exponent == 0 ? std::ldexp(mantissa, -24) : std::ldexp(1024 + mantissa, exponent - 25);
+		return (half & 0x8000) ? -value : value;
+	}
+
+	//Packs every value once in a single call, which goes through SSE2 for all but the last few, and once per call, which
+	//always takes the scalar path, and only passes when both give the expected half
+	static bool packsTo(const std::vector<float>& values, const std::vector<uint16_t>& expected)
+	{
+		std::vector<uint16_t> halves(values.size());
+		HdrPacker::packHalf(values.data(), halves.data(), values.size());
+		bool matched = halves == expected;
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			uint16_t half;
+			HdrPacker::packHalf(&values[i], &half, 1);
+			matched &= half == expected[i];
+		}
+		return matched;
+	}
+
+	static void testHalfRounding()
+	{
+		//Every finite positive half, the midpoint to the next one and the floats right either side of that midpoint. Midpoints
+		//round to the even half, covering subnormals and the step from the largest subnormal to the smallest normal
+		std::vector<float> values;
+		std::vector<uint16_t> expected;
+		for (uint16_t half = 0; half < 0x7BFF; half++)
+		{
+			float value = static_cast<float>(halfToDouble(half));
+			float midpoint = static_cast<float>((halfToDouble(half) + halfToDouble(half + 1)) / 2.0);
+			uint16_t even = (half & 1) ? half + 1 : half;
+			values.insert(values.end(), { value, std::nextafter(midpoint, 0.0f), midpoint, std::nextafter(midpoint, 1.0e6f) });
+			expected.insert(expected.end(), { half, half, even, static_cast<uint16_t>(half + 1) });
+		}
+		values.push_back(65504.0f);
+		expected.push_back(0x7BFF);
+		check(packsTo(values, expected), "half: finite values round to the nearest half, ties to even");
+
+		for (float& value : values)
+		{
+			value = -value;
+		}
+		for (uint16_t& half : expected)
+		{
+			half |= 0x8000;
+		}
+		check(packsTo(values, expected), "half: negative values round the same way with the sign set");
+	}
+
+	static void testHalfSpecialValues()
+	{
+		const float infinity = std::numeric_limits<float>::infinity();
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		float negativeNan = -nan;
+		float signalingNan = std::numeric_limits<float>::signaling_NaN();
+
+		check(packsTo({ 65520.0f, 1.0e10f, infinity, -65520.0f, -infinity }, { 0x7BFF, 0x7BFF, 0x7BFF, 0xFBFF, 0xFBFF }),
+			"half: values past the range clamp to the largest finite half");
+		check(packsTo({ nan, negativeNan, signalingNan, 1.0f, nan }, { 0, 0, 0, 0x3C00, 0 }), "half: NaNs become 0");
+		check(packsTo({ std::numeric_limits<float>::denorm_min(), 1.0e-38f, -1.0e-38f, -0.0f, 0.0f },
+			{ 0, 0, 0x8000, 0x8000, 0 }), "half: float subnormals and zeros keep only their sign");
+		check(packsTo({ std::ldexp(1.0f, -24), std::ldexp(1.0f, -25), std::ldexp(1.5f, -25), std::ldexp(1.0f, -14) },
+			{ 0x0001, 0x0000, 0x0001, 0x0400 }), "half: the smallest subnormal rounds like any other half");
+	}
+
+	//The conversion in the Vulkan spec, in doubles so nothing in it rounds
+	static uint32_t packSharedExponentReference(const float* texel)
+	{
+		const double maxValue = 511.0 / 512.0 * 65536.0;
+		double rgb[3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			rgb[c] = texel[c] > 0.0f ? std::min(static_cast<double>(texel[c]), maxValue) : 0.0;
+		}
+		double maxChannel = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+
+		int exponent = maxChannel > 0.0 ? std::max(-16, static_cast<int>(std::floor(std::log2(maxChannel)))) + 16 : 0;
+		if (std::floor(maxChannel / std::ldexp(1.0, exponent - 24) + 0.5) == 512.0)
+		{
+			exponent++;
+		}
+
+		uint32_t packed = static_cast<uint32_t>(exponent) << 27;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			packed |= static_cast<uint32_t>(std::floor(rgb[c] / std::ldexp(1.0, exponent - 24) + 0.5)) << (c * 9);
+		}
+		return packed;
+	}
+
+	static bool packsSharedExponentLikeReference(const std::vector<float>& texels)
+	{
+		size_t texelCount = texels.size() / 4;
+		std::vector<uint32_t> packed(texelCount);
+		HdrPacker::packSharedExponent(texels.data(), packed.data(), texelCount);
+		bool matched = true;
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			uint32_t scalar;
+			HdrPacker::packSharedExponent(&texels[i * 4], &scalar, 1);
+			uint32_t expected = packSharedExponentReference(&texels[i * 4]);
+			if (packed[i] != expected || scalar != expected)
+			{
+				std::cout << "  texel " << texels[i * 4] << ", " << texels[i * 4 + 1] << ", " << texels[i * 4 + 2] << std::hex
+					<< " packed 0x" << packed[i] << ", scalar 0x" << scalar << ", expected 0x" << expected << std::dec << std::endl;
+				matched = false;
+			}
+		}
+		return matched;
+	}
+
+	static void testSharedExponent()
+	{
+		const float infinity = std::numeric_limits<float>::infinity();
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		//Channels sitting right on, above and below a rounding midpoint or the carry into the next exponent
+		std::vector<float> texels = {
+			0.0f, 0.0f, 0.0f, 1.0f,
+			1.0f, 0.5f, 0.25f, 1.0f,
+			65408.0f, 1.0e10f, infinity, 1.0f,
+			-1.0f, -infinity, nan, 1.0f,
+			nan, 2.0f, -0.0f, 1.0f,
+			511.5f, 1.0f, 0.0f, 1.0f,
+			511.49997f, 1.0f, 0.0f, 1.0f,
+			std::ldexp(1023.0f, -26), 0.0f, 0.0f, 1.0f,
+			std::ldexp(1.0f, -24), std::ldexp(1.0f, -25), std::ldexp(1.0f, -26), 1.0f,
+			std::numeric_limits<float>::denorm_min(), 1.0e-38f, std::ldexp(1.0f, -16), 1.0f,
+			1.0f, std::ldexp(1.0f, -9), std::nextafter(std::ldexp(1.0f, -9), 0.0f), 1.0f,
+			1.0f, std::ldexp(3.0f, -10), std::nextafter(std::ldexp(3.0f, -10), 0.0f), 1.0f,
+			256.0f, std::nextafter(0.25f, 0.0f), 0.75f, 1.0f,
+		};
+		check(packsSharedExponentLikeReference(texels), "shared exponent: edge cases match the spec conversion");
+
+		//Random texels across the whole range, with channels spread over very different magnitudes
+		std::mt19937 random{ 1234 };
+		std::uniform_real_distribution<float> exponent{ -30.0f, 17.0f };
+		texels.clear();
+		for (uint32_t i = 0; i < 4 * 10003; i++)
+		{
+			texels.push_back(std::exp2(exponent(random)) * (random() % 8 == 0 ? -1.0f : 1.0f));
+		}
+		check(packsSharedExponentLikeReference(texels), "shared exponent: random texels match the spec conversion");
+	}
+
+	static void testHalfUnpack()
+	{
+		//Every half, through SSE2 for all of them and through the scalar path one at a time
+		std::vector<uint16_t> halves(0x10000);
+		for (uint32_t i = 0; i < 0x10000; i++)
+		{
+			halves[i] = static_cast<uint16_t>(i);
+		}
+		std::vector<float> values(halves.size());
+		HdrPacker::unpackHalf(halves.data(), values.data(), halves.size());
+
+		bool pathsMatched = true;
+		bool finiteMatched = true;
+		bool specialMatched = true;
+		for (uint32_t i = 0; i < 0x10000; i++)
+		{
+			float scalar;
+			HdrPacker::unpackHalf(&halves[i], &scalar, 1);
+			uint32_t bits;
+			uint32_t scalarBits;
+			memcpy(&bits, &values[i], sizeof(bits));
+			memcpy(&scalarBits, &scalar, sizeof(scalarBits));
+			pathsMatched &= bits == scalarBits;
+
+			uint32_t magnitude = i & 0x7FFF;
+			if (magnitude < 0x7C00)
+			{
+				finiteMatched &= static_cast<double>(values[i]) == halfToDouble(halves[i]) && std::signbit(values[i]) == ((i & 0x8000) != 0);
+			}
+			else if (magnitude == 0x7C00)
+			{
+				specialMatched &= std::isinf(values[i]) && std::signbit(values[i]) == ((i & 0x8000) != 0);
+			}
+			else
+			{
+				specialMatched &= std::isnan(values[i]);
+			}
+		}
+		check(pathsMatched, "unpack: both paths give the same bits");
+		check(finiteMatched, "unpack: every finite half and signed zero is exact");
+		check(specialMatched, "unpack: infinities and NaNs stay infinities and NaNs");
+	}
+
+	void testHdrPacker()
+	{
+		testHalfRounding();
+		testHalfSpecialValues();
+		testSharedExponent();
+		testHalfUnpack();
+	}
+}
\ No newline at end of file
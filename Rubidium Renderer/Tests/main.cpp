@@ -0,0 +1,17 @@
+#include "tests.hpp"
+
+#include <cstdlib>
+
+int main()
+{
+	rub::tests::testRangeAllocator();
+	rub::tests::testHdrPacker();
+
+	if (rub::tests::failureCount > 0)
+	{
+		std::cout << rub::tests::failureCount << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "tests.hpp"
+#include "../Rubidium Renderer/range_allocator.hpp"
+
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace rub::tests
+{
+	static void testBestFit()
+	{
+		//Free ranges of 30 at 10 and 20 at 50, with allocations kept between them so they can't merge
+		RangeAllocator allocator{ 100 };
+		allocator.allocate(10);
+		uint64_t thirty = allocator.allocate(30);
+		allocator.allocate(10);
+		uint64_t twenty = allocator.allocate(20);
+		allocator.allocate(30);
+		check(allocator.getFreeSize() == 0, "best fit: the allocations fill the capacity");
+		allocator.free(thirty);
+		allocator.free(twenty);
+
+		check(allocator.allocate(15) == 50, "best fit: takes the smallest range that fits");
+		check(allocator.allocate(25) == 10, "best fit: falls back to the larger range");
+		check(allocator.getFreeSize() == 10, "best fit: the remainders stay free");
+		check(allocator.allocate(6) == RangeAllocator::INVALID, "best fit: no single range is large enough");
+		uint64_t left = allocator.allocate(5);
+		uint64_t right = allocator.allocate(5);
+		check((left == 35 && right == 65) || (left == 65 && right == 35), "best fit: both remainders are used up exactly");
+		check(allocator.getFreeSize() == 0, "best fit: nothing is left");
+	}
+
+	static void testCoalescing()
+	{
+		RangeAllocator allocator{ 100 };
+		uint64_t first = allocator.allocate(25);
+		uint64_t second = allocator.allocate(25);
+		uint64_t third = allocator.allocate(25);
+		uint64_t fourth = allocator.allocate(25);
+
+		//Merging with the range after
+		allocator.free(third);
+		allocator.free(second);
+		check(allocator.allocate(50) == 25, "coalescing: a range merges with the free range after it");
+		allocator.free(25);
+
+		//Merging with the range before
+		allocator.free(first);
+		check(allocator.allocate(75) == 0, "coalescing: a range merges with the free range before it");
+		allocator.free(0);
+
+		//Merging on both sides at once, which leaves a single range covering the capacity
+		first = allocator.allocate(25);
+		second = allocator.allocate(50);
+		check(first == 0 && second == 25, "coalescing: merged ranges are split again from the front");
+		allocator.free(first);
+		allocator.free(fourth);
+		allocator.free(second);
+		check(allocator.getFreeSize() == 100, "coalescing: all of the capacity is free");
+		check(allocator.allocate(100) == 0, "coalescing: a range merges with both neighbours");
+	}
+
+	static void testInvalidRequests()
+	{
+		RangeAllocator allocator{ 64 };
+		check(allocator.allocate(0) == RangeAllocator::INVALID, "invalid: an empty range is refused");
+		check(allocator.allocate(65) == RangeAllocator::INVALID, "invalid: a range past the capacity is refused");
+		check(allocator.getFreeSize() == 64, "invalid: refused requests take nothing");
+
+		uint64_t offset = allocator.allocate(8);
+		allocator.free(offset);
+		bool threw = false;
+		try
+		{
+			allocator.free(offset);
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+		check(threw, "invalid: freeing a range twice throws");
+
+		RangeAllocator empty{ 0 };
+		check(empty.allocate(1) == RangeAllocator::INVALID, "invalid: an empty allocator hands out nothing");
+	}
+
+	static void testRandomAgainstReference()
+	{
+		//Every unit is tracked by hand, so overlapping ranges or lost free space show up straight away
+		constexpr uint64_t capacity = 4096;
+		RangeAllocator allocator{ capacity };
+		std::vector<bool> used(capacity, false);
+		std::vector<std::pair<uint64_t, uint64_t>> live;
+		std::mt19937 random{ 1234 };
+
+		bool overlapped = false;
+		bool sizeMatched = true;
+		for (uint32_t step = 0; step < 20000; step++)
+		{
+			if (live.empty() || random() % 3 != 0)
+			{
+				uint64_t size = 1 + random() % 64;
+				uint64_t offset = allocator.allocate(size);
+				if (offset == RangeAllocator::INVALID)
+				{
+					continue;
+				}
+				for (uint64_t unit = offset; unit < offset + size; unit++)
+				{
+					overlapped |= unit >= capacity || used[unit];
+					used[unit] = true;
+				}
+				live.push_back({ offset, size });
+			}
+			else
+			{
+				size_t index = random() % live.size();
+				allocator.free(live[index].first);
+				for (uint64_t unit = live[index].first; unit < live[index].first + live[index].second; unit++)
+				{
+					used[unit] = false;
+				}
+				live[index] = live.back();
+				live.pop_back();
+			}
+
+			uint64_t usedSize = 0;
+			for (const auto& range : live)
+			{
+				usedSize += range.second;
+			}
+			sizeMatched &= allocator.getFreeSize() == capacity - usedSize;
+		}
+		check(!overlapped, "random: no two live ranges overlap");
+		check(sizeMatched, "random: the free size matches the live ranges");
+
+		for (const auto& range : live)
+		{
+			allocator.free(range.first);
+		}
+		check(allocator.allocate(capacity) == 0, "random: freeing everything merges back into one range");
+	}
+
+	void testRangeAllocator()
+	{
+		testBestFit();
+		testCoalescing();
+		testInvalidRequests();
+		testRandomAgainstReference();
+	}
+}
\ No newline at end of file
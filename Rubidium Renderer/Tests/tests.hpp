@@ -0,0 +1,21 @@
+#pragma once
+
+#include <iostream>
+
+namespace rub::tests
+{
+	//A failed check is reported and counted instead of stopping the run, so one run lists everything that broke
+	inline int failureCount = 0;
+
+	inline void check(bool condition, const char* description)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << description << std::endl;
+			failureCount++;
+		}
+	}
+
+	void testRangeAllocator();
+	void testHdrPacker();
+}
\ No newline at end of file
@@ -0,0 +1,880 @@
+#include "block_compressor.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace rub
+{
+	//One array per channel, so the index search handles four texels per instruction
+	struct BlockChannels
+	{
+		alignas(16) float values[4][BlockCompressor::BLOCK_TEXELS];
+		uint32_t channelCount;
+	};
+
+	//Decoded colours an endpoint pair can produce, stored by channel like the block
+	struct Palette
+	{
+		float values[4][16];
+		uint32_t size;
+	};
+
+	//Writes fields least significant bit first, the order every BC6H and BC7 field is stored in
+	struct BitWriter
+	{
+		uint8_t* block;
+		uint32_t position = 0;
+
+		BitWriter(uint8_t* block) : block{ block }
+		{
+			memset(block, 0, 16);
+		}
+
+		void write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t i = 0; i < bits; i++, position++)
+			{
+				block[position >> 3] |= ((value >> i) & 1) << (position & 7);
+			}
+		}
+	};
+
+	static constexpr uint32_t ALL_TEXELS = 0xFFFF;
+	static constexpr uint32_t REFINE_ITERATIONS = 3;
+	//Two subset partitions that get a full encode after the quick ranking
+	static constexpr uint32_t PARTITION_CANDIDATES = 4;
+	//Summed squared error below which a mode 6 block is kept without trying mode 1. Most blocks of real textures land under it,
+	//and searching the partitions costs twenty times as much as mode 6
+	static constexpr float MODE1_ERROR_THRESHOLD = 64.0f;
+	static constexpr float MAX_HALF = 0x7BFF;
+
+	static const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static const uint32_t BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	static const uint32_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	//Texels in the second subset of each two subset partition, and that subset's anchor texel
+	static const uint16_t BC7_PARTITIONS2[64] = {
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+	static const uint8_t BC7_ANCHORS2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+
+	static BlockChannels loadChannels(const uint8_t* pixels, uint32_t channelCount)
+	{
+		BlockChannels channels;
+		channels.channelCount = channelCount;
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				channels.values[c][i] = pixels[i * 4 + c];
+			}
+		}
+		return channels;
+	}
+
+	//Finds the palette entry closest to each texel. errors gets each texel's squared distance to it and the sum is returned
+	static float selectIndices(const BlockChannels& channels, const Palette& palette, uint8_t* indices, float* errors)
+	{
+#if defined(BLOCK_COMPRESSOR_SSE2)
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i += 4)
+		{
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (uint32_t k = 0; k < palette.size; k++)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (uint32_t c = 0; c < channels.channelCount; c++)
+				{
+					__m128 difference = _mm_sub_ps(_mm_load_ps(&channels.values[c][i]), _mm_set1_ps(palette.values[c][k]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(k))), _mm_andnot_si128(closer, bestIndex));
+			}
+
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+			_mm_storeu_ps(&errors[i], best);
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				indices[i + j] = static_cast<uint8_t>(lanes[j]);
+			}
+		}
+#else
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			errors[i] = FLT_MAX;
+			for (uint32_t k = 0; k < palette.size; k++)
+			{
+				float distance = 0.0f;
+				for (uint32_t c = 0; c < channels.channelCount; c++)
+				{
+					float difference = channels.values[c][i] - palette.values[c][k];
+					distance += difference * difference;
+				}
+				if (distance < errors[i])
+				{
+					errors[i] = distance;
+					indices[i] = static_cast<uint8_t>(k);
+				}
+			}
+		}
+#endif
+
+		float total = 0.0f;
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			total += errors[i];
+		}
+		return total;
+	}
+
+	static float maskedError(const float* errors, uint32_t mask)
+	{
+		float total = 0.0f;
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			if (mask & (1 << i))
+			{
+				total += errors[i];
+			}
+		}
+		return total;
+	}
+
+	//Endpoints at the extremes of the masked texels projected onto their principal axis, found by power iteration
+	static void fitLine(const BlockChannels& channels, uint32_t mask, float maxValue, float* e0, float* e1)
+	{
+		uint32_t channelCount = channels.channelCount;
+		float mean[4] = {};
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			if (mask & (1 << i))
+			{
+				for (uint32_t c = 0; c < channelCount; c++)
+				{
+					mean[c] += channels.values[c][i];
+				}
+				count++;
+			}
+		}
+		for (uint32_t c = 0; c < channelCount; c++)
+		{
+			mean[c] /= static_cast<float>(std::max(count, 1u));
+		}
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			if (mask & (1 << i))
+			{
+				for (uint32_t a = 0; a < channelCount; a++)
+				{
+					for (uint32_t b = 0; b < channelCount; b++)
+					{
+						covariance[a][b] += (channels.values[a][i] - mean[a]) * (channels.values[b][i] - mean[b]);
+					}
+				}
+			}
+		}
+
+		//Starting from the channel with the most spread converges in a few steps for all but the flattest blocks
+		float axis[4] = {};
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < channelCount; c++)
+		{
+			if (covariance[c][c] > covariance[widest][widest])
+			{
+				widest = c;
+			}
+		}
+		axis[widest] = 1.0f;
+		for (uint32_t iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (uint32_t a = 0; a < channelCount; a++)
+			{
+				for (uint32_t b = 0; b < channelCount; b++)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+			if (length < 1e-12f)
+			{
+				break;
+			}
+			length = std::sqrt(length);
+			for (uint32_t c = 0; c < channelCount; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float lowest = FLT_MAX;
+		float highest = -FLT_MAX;
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			if (mask & (1 << i))
+			{
+				float t = 0.0f;
+				for (uint32_t c = 0; c < channelCount; c++)
+				{
+					t += (channels.values[c][i] - mean[c]) * axis[c];
+				}
+				lowest = std::min(lowest, t);
+				highest = std::max(highest, t);
+			}
+		}
+		if (lowest > highest)
+		{
+			lowest = highest = 0.0f;
+		}
+
+		for (uint32_t c = 0; c < channelCount; c++)
+		{
+			e0[c] = std::clamp(mean[c] + axis[c] * lowest, 0.0f, maxValue);
+			e1[c] = std::clamp(mean[c] + axis[c] * highest, 0.0f, maxValue);
+		}
+	}
+
+	//Least squares endpoints for texels already placed along the line by their weights, 0 at e0 and 1 at e1.
+	//Fails when every texel has the same weight, which leaves the endpoints undetermined
+	static bool refineEndpoints(const BlockChannels& channels, uint32_t mask, const float* weights, float maxValue, float* e0, float* e1)
+	{
+		float aa = 0.0f;
+		float bb = 0.0f;
+		float ab = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			if (mask & (1 << i))
+			{
+				float b = weights[i];
+				float a = 1.0f - b;
+				aa += a * a;
+				bb += b * b;
+				ab += a * b;
+				for (uint32_t c = 0; c < channels.channelCount; c++)
+				{
+					ax[c] += a * channels.values[c][i];
+					bx[c] += b * channels.values[c][i];
+				}
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+		for (uint32_t c = 0; c < channels.channelCount; c++)
+		{
+			e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, maxValue);
+			e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, maxValue);
+		}
+		return true;
+	}
+
+	static void weightsFromIndices(const uint8_t* indices, const uint32_t* indexWeights, float* weights)
+	{
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			weights[i] = indexWeights[indices[i]] / 64.0f;
+		}
+	}
+
+	static uint16_t packRGB565(const float* color)
+	{
+		uint32_t r = static_cast<uint32_t>(std::clamp(std::lround(color[0] * 31.0f / 255.0f), 0l, 31l));
+		uint32_t g = static_cast<uint32_t>(std::clamp(std::lround(color[1] * 63.0f / 255.0f), 0l, 63l));
+		uint32_t b = static_cast<uint32_t>(std::clamp(std::lround(color[2] * 31.0f / 255.0f), 0l, 31l));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	static void unpackRGB565(uint16_t packed, float* color)
+	{
+		uint32_t r = packed >> 11;
+		uint32_t g = (packed >> 5) & 63;
+		uint32_t b = packed & 31;
+		color[0] = static_cast<float>((r << 3) | (r >> 2));
+		color[1] = static_cast<float>((g << 2) | (g >> 4));
+		color[2] = static_cast<float>((b << 3) | (b >> 2));
+	}
+
+	void BlockCompressor::encodeBC1(const uint8_t* pixels, uint8_t* block)
+	{
+		BlockChannels channels = loadChannels(pixels, 3);
+		float e0[4];
+		float e1[4];
+		fitLine(channels, ALL_TEXELS, 255.0f, e0, e1);
+
+		uint16_t best[2] = {};
+		uint8_t bestIndices[BLOCK_TEXELS] = {};
+		float bestError = FLT_MAX;
+		for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS; iteration++)
+		{
+			uint16_t endpoints[2] = { packRGB565(e0), packRGB565(e1) };
+			float c0[3];
+			float c1[3];
+			unpackRGB565(endpoints[0], c0);
+			unpackRGB565(endpoints[1], c1);
+
+			Palette palette;
+			palette.size = 4;
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette.values[c][0] = c0[c];
+				palette.values[c][1] = c1[c];
+				palette.values[c][2] = (2.0f * c0[c] + c1[c]) / 3.0f;
+				palette.values[c][3] = (c0[c] + 2.0f * c1[c]) / 3.0f;
+			}
+
+			uint8_t indices[BLOCK_TEXELS];
+			float errors[BLOCK_TEXELS];
+			float error = selectIndices(channels, palette, indices, errors);
+			if (error < bestError)
+			{
+				bestError = error;
+				best[0] = endpoints[0];
+				best[1] = endpoints[1];
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			float weights[BLOCK_TEXELS];
+			for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+			{
+				weights[i] = BC1_WEIGHTS[indices[i]];
+			}
+			if (!refineEndpoints(channels, ALL_TEXELS, weights, 255.0f, e0, e1))
+			{
+				break;
+			}
+		}
+
+		//Four colour mode needs the first endpoint to be the larger, swapping them swaps indices 0 with 1 and 2 with 3.
+		//Equal endpoints would select three colour mode, where index 3 is black
+		if (best[0] < best[1])
+		{
+			std::swap(best[0], best[1]);
+			for (uint8_t& index : bestIndices)
+			{
+				index ^= 1;
+			}
+		}
+		else if (best[0] == best[1])
+		{
+			memset(bestIndices, 0, sizeof(bestIndices));
+		}
+
+		uint32_t indexBits = 0;
+		for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			indexBits |= static_cast<uint32_t>(bestIndices[i]) << (i * 2);
+		}
+		block[0] = best[0] & 0xFF;
+		block[1] = best[0] >> 8;
+		block[2] = best[1] & 0xFF;
+		block[3] = best[1] >> 8;
+		memcpy(block + 4, &indexBits, sizeof(indexBits));
+	}
+
+	void BlockCompressor::encodeBC4(const uint8_t* pixels, uint32_t channel, uint8_t* block)
+	{
+		BlockChannels channels;
+		channels.channelCount = 1;
+		uint32_t lowest = 255;
+		uint32_t highest = 0;
+		for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			uint32_t value = pixels[i * 4 + channel];
+			channels.values[0][i] = static_cast<float>(value);
+			lowest = std::min(lowest, value);
+			highest = std::max(highest, value);
+		}
+
+		//Equal endpoints select the six value mode, where index 0 is still the first endpoint
+		uint32_t best[2] = { highest, highest };
+		uint8_t bestIndices[BLOCK_TEXELS] = {};
+		float bestError = FLT_MAX;
+		//Pulling the endpoints in a little often fits the texels between them better than the extremes do
+		for (uint32_t inset0 = 0; inset0 < 4 && lowest != highest; inset0++)
+		{
+			for (uint32_t inset1 = 0; inset1 < 4; inset1++)
+			{
+				int32_t r0 = static_cast<int32_t>(highest - inset0);
+				int32_t r1 = static_cast<int32_t>(lowest + inset1);
+				if (r0 <= r1)
+				{
+					continue;
+				}
+
+				Palette palette;
+				palette.size = 8;
+				palette.values[0][0] = static_cast<float>(r0);
+				palette.values[0][1] = static_cast<float>(r1);
+				for (uint32_t k = 2; k < 8; k++)
+				{
+					palette.values[0][k] = ((8 - k) * r0 + (k - 1) * r1) / 7.0f;
+				}
+
+				uint8_t indices[BLOCK_TEXELS];
+				float errors[BLOCK_TEXELS];
+				float error = selectIndices(channels, palette, indices, errors);
+				if (error < bestError)
+				{
+					bestError = error;
+					best[0] = r0;
+					best[1] = r1;
+					memcpy(bestIndices, indices, sizeof(indices));
+				}
+			}
+		}
+
+		uint64_t indexBits = 0;
+		for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			indexBits |= static_cast<uint64_t>(bestIndices[i]) << (i * 3);
+		}
+		block[0] = static_cast<uint8_t>(best[0]);
+		block[1] = static_cast<uint8_t>(best[1]);
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			block[2 + i] = static_cast<uint8_t>(indexBits >> (i * 8));
+		}
+	}
+
+	void BlockCompressor::encodeBC5(const uint8_t* pixels, uint8_t* block)
+	{
+		encodeBC4(pixels, 0, block);
+		encodeBC4(pixels, 1, block + 8);
+	}
+
+	//Rounds endpoints to colorBits per channel plus one p-bit shared between them, keeping whichever p-bit lands closer.
+	//quantized gets the channel values without the p-bit
+	static uint32_t quantizeWithPBit(const float (*endpoints)[4], uint32_t endpointCount, uint32_t channelCount, uint32_t colorBits,
+		uint32_t (*quantized)[4])
+	{
+		uint32_t maxValue = (1 << colorBits) - 1;
+		float bestError = FLT_MAX;
+		uint32_t bestPBit = 0;
+		for (uint32_t pbit = 0; pbit < 2; pbit++)
+		{
+			float error = 0.0f;
+			uint32_t candidate[2][4];
+			for (uint32_t e = 0; e < endpointCount; e++)
+			{
+				for (uint32_t c = 0; c < channelCount; c++)
+				{
+					//Scale to the precision with the p-bit, then drop the p-bit
+					float scaled = endpoints[e][c] * ((maxValue << 1) | 1) / 255.0f;
+					candidate[e][c] = static_cast<uint32_t>(std::clamp(std::lround((scaled - pbit) / 2.0f), 0l, static_cast<long>(maxValue)));
+
+					uint32_t value = ((candidate[e][c] << 1) | pbit) << (7 - colorBits);
+					float decoded = static_cast<float>(value | (value >> (colorBits + 1)));
+					error += (decoded - endpoints[e][c]) * (decoded - endpoints[e][c]);
+				}
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				bestPBit = pbit;
+				memcpy(quantized, candidate, sizeof(uint32_t) * 4 * endpointCount);
+			}
+		}
+		return bestPBit;
+	}
+
+	static Palette bc7Palette(const uint32_t (*quantized)[4], const uint32_t* pbits, uint32_t channelCount, uint32_t colorBits,
+		const uint32_t* weights, uint32_t size)
+	{
+		uint32_t decoded[2][4];
+		for (uint32_t e = 0; e < 2; e++)
+		{
+			for (uint32_t c = 0; c < channelCount; c++)
+			{
+				uint32_t value = ((quantized[e][c] << 1) | pbits[e]) << (7 - colorBits);
+				decoded[e][c] = value | (value >> (colorBits + 1));
+			}
+		}
+
+		Palette palette;
+		palette.size = size;
+		for (uint32_t k = 0; k < size; k++)
+		{
+			for (uint32_t c = 0; c < channelCount; c++)
+			{
+				palette.values[c][k] = static_cast<float>(((64 - weights[k]) * decoded[0][c] + weights[k] * decoded[1][c] + 32) >> 6);
+			}
+		}
+		return palette;
+	}
+
+	//One subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices
+	static float encodeBC7Mode6(const BlockChannels& channels, uint8_t* block)
+	{
+		float endpoints[2][4];
+		fitLine(channels, ALL_TEXELS, 255.0f, endpoints[0], endpoints[1]);
+
+		uint32_t best[2][4] = {};
+		uint32_t bestPBits[2] = {};
+		uint8_t bestIndices[BlockCompressor::BLOCK_TEXELS] = {};
+		float bestError = FLT_MAX;
+		for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS; iteration++)
+		{
+			uint32_t quantized[2][4];
+			uint32_t pbits[2];
+			pbits[0] = quantizeWithPBit(&endpoints[0], 1, 4, 7, &quantized[0]);
+			pbits[1] = quantizeWithPBit(&endpoints[1], 1, 4, 7, &quantized[1]);
+			Palette palette = bc7Palette(quantized, pbits, 4, 7, BC7_WEIGHTS4, 16);
+
+			uint8_t indices[BlockCompressor::BLOCK_TEXELS];
+			float errors[BlockCompressor::BLOCK_TEXELS];
+			float error = selectIndices(channels, palette, indices, errors);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(best, quantized, sizeof(quantized));
+				memcpy(bestPBits, pbits, sizeof(pbits));
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			float weights[BlockCompressor::BLOCK_TEXELS];
+			weightsFromIndices(indices, BC7_WEIGHTS4, weights);
+			if (!refineEndpoints(channels, ALL_TEXELS, weights, 255.0f, endpoints[0], endpoints[1]))
+			{
+				break;
+			}
+		}
+
+		//The anchor texel's index has an implicit zero top bit, swapping the endpoints mirrors every index
+		if (bestIndices[0] & 8)
+		{
+			std::swap(best[0], best[1]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (uint8_t& index : bestIndices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		BitWriter writer(block);
+		writer.write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.write(best[0][c], 7);
+			writer.write(best[1][c], 7);
+		}
+		writer.write(bestPBits[0], 1);
+		writer.write(bestPBits[1], 1);
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			writer.write(bestIndices[i], i == 0 ? 3 : 4);
+		}
+		return bestError;
+	}
+
+	//Two subsets of opaque RGB, 6 bit endpoints with a p-bit per subset and 3 bit indices
+	static float encodeBC7Mode1(const BlockChannels& channels, uint8_t* block)
+	{
+		//Rank every partition by how well unquantized lines through its subsets fit, then encode the most promising properly
+		std::pair<float, uint32_t> ranked[64];
+		for (uint32_t partition = 0; partition < 64; partition++)
+		{
+			uint32_t masks[2] = { ~BC7_PARTITIONS2[partition] & ALL_TEXELS, BC7_PARTITIONS2[partition] };
+			float error = 0.0f;
+			for (uint32_t subset = 0; subset < 2; subset++)
+			{
+				float endpoints[2][4];
+				fitLine(channels, masks[subset], 255.0f, endpoints[0], endpoints[1]);
+
+				Palette palette;
+				palette.size = 8;
+				for (uint32_t k = 0; k < 8; k++)
+				{
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						palette.values[c][k] = endpoints[0][c] + (endpoints[1][c] - endpoints[0][c]) * BC7_WEIGHTS3[k] / 64.0f;
+					}
+				}
+				uint8_t indices[BlockCompressor::BLOCK_TEXELS];
+				float errors[BlockCompressor::BLOCK_TEXELS];
+				selectIndices(channels, palette, indices, errors);
+				error += maskedError(errors, masks[subset]);
+			}
+			ranked[partition] = { error, partition };
+		}
+		std::partial_sort(ranked, ranked + PARTITION_CANDIDATES, ranked + 64);
+
+		uint32_t bestPartition = 0;
+		uint32_t best[2][2][4] = {};
+		uint32_t bestPBits[2] = {};
+		uint8_t bestIndices[BlockCompressor::BLOCK_TEXELS] = {};
+		float bestError = FLT_MAX;
+		for (uint32_t candidate = 0; candidate < PARTITION_CANDIDATES; candidate++)
+		{
+			uint32_t partition = ranked[candidate].second;
+			uint32_t masks[2] = { ~BC7_PARTITIONS2[partition] & ALL_TEXELS, BC7_PARTITIONS2[partition] };
+			float endpoints[2][2][4];
+			for (uint32_t subset = 0; subset < 2; subset++)
+			{
+				fitLine(channels, masks[subset], 255.0f, endpoints[subset][0], endpoints[subset][1]);
+			}
+
+			for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS; iteration++)
+			{
+				uint32_t quantized[2][2][4];
+				uint32_t pbits[2];
+				uint8_t indices[BlockCompressor::BLOCK_TEXELS];
+				float error = 0.0f;
+				for (uint32_t subset = 0; subset < 2; subset++)
+				{
+					pbits[subset] = quantizeWithPBit(endpoints[subset], 2, 3, 6, quantized[subset]);
+					uint32_t subsetPBits[2] = { pbits[subset], pbits[subset] };
+					Palette palette = bc7Palette(quantized[subset], subsetPBits, 3, 6, BC7_WEIGHTS3, 8);
+
+					uint8_t subsetIndices[BlockCompressor::BLOCK_TEXELS];
+					float errors[BlockCompressor::BLOCK_TEXELS];
+					selectIndices(channels, palette, subsetIndices, errors);
+					error += maskedError(errors, masks[subset]);
+					for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+					{
+						if (masks[subset] & (1 << i))
+						{
+							indices[i] = subsetIndices[i];
+						}
+					}
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					bestPartition = partition;
+					memcpy(best, quantized, sizeof(quantized));
+					memcpy(bestPBits, pbits, sizeof(pbits));
+					memcpy(bestIndices, indices, sizeof(indices));
+				}
+
+				float weights[BlockCompressor::BLOCK_TEXELS];
+				weightsFromIndices(indices, BC7_WEIGHTS3, weights);
+				bool refined = false;
+				for (uint32_t subset = 0; subset < 2; subset++)
+				{
+					refined |= refineEndpoints(channels, masks[subset], weights, 255.0f, endpoints[subset][0], endpoints[subset][1]);
+				}
+				if (!refined)
+				{
+					break;
+				}
+			}
+		}
+
+		//Each subset's anchor texel has an implicit zero top bit in its index
+		uint32_t anchors[2] = { 0, BC7_ANCHORS2[bestPartition] };
+		for (uint32_t subset = 0; subset < 2; subset++)
+		{
+			if (!(bestIndices[anchors[subset]] & 4))
+			{
+				continue;
+			}
+
+			std::swap(best[subset][0], best[subset][1]);
+			bool inSecond = subset == 1;
+			for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+			{
+				if (((BC7_PARTITIONS2[bestPartition] >> i) & 1) == inSecond)
+				{
+					bestIndices[i] = 7 - bestIndices[i];
+				}
+			}
+		}
+
+		BitWriter writer(block);
+		writer.write(1 << 1, 2);
+		writer.write(bestPartition, 6);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			for (uint32_t subset = 0; subset < 2; subset++)
+			{
+				writer.write(best[subset][0][c], 6);
+				writer.write(best[subset][1][c], 6);
+			}
+		}
+		writer.write(bestPBits[0], 1);
+		writer.write(bestPBits[1], 1);
+		for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+		{
+			writer.write(bestIndices[i], i == anchors[0] || i == anchors[1] ? 2 : 3);
+		}
+		return bestError;
+	}
+
+	void BlockCompressor::encodeBC7(const uint8_t* pixels, uint8_t* block)
+	{
+		BlockChannels channels = loadChannels(pixels, 4);
+		float error = encodeBC7Mode6(channels, block);
+
+		bool opaque = true;
+		for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			opaque &= pixels[i * 4 + 3] == 255;
+		}
+		if (!opaque || error < MODE1_ERROR_THRESHOLD)
+		{
+			return;
+		}
+
+		//Mode 1 decodes alpha as opaque, so it only has colour to compete on
+		BlockChannels color = channels;
+		color.channelCount = 3;
+		uint8_t twoSubsets[16];
+		if (encodeBC7Mode1(color, twoSubsets) < error)
+		{
+			memcpy(block, twoSubsets, sizeof(twoSubsets));
+		}
+	}
+
+	static uint32_t unquantizeBC6H(uint32_t value)
+	{
+		if (value == 0)
+		{
+			return 0;
+		}
+		if (value == 1023)
+		{
+			return 0xFFFF;
+		}
+		return ((value << 16) + 0x8000) >> 10;
+	}
+
+	//Unsigned BC6H scales interpolated values by 31/64 to land in the finite half float range
+	static uint32_t finishBC6H(uint32_t interpolated)
+	{
+		return (interpolated * 31) >> 6;
+	}
+
+	//Closest 10 bit endpoint to a half float bit pattern, searched around the inverse of the unquantization
+	static uint32_t quantizeBC6H(float value)
+	{
+		long guess = std::lround((value * 64.0f / 31.0f - 32.0f) / 64.0f);
+		uint32_t best = 0;
+		float bestError = FLT_MAX;
+		for (long candidate = guess - 1; candidate <= guess + 1; candidate++)
+		{
+			uint32_t quantized = static_cast<uint32_t>(std::clamp(candidate, 0l, 1023l));
+			float error = std::abs(static_cast<float>(finishBC6H(unquantizeBC6H(quantized))) - value);
+			if (error < bestError)
+			{
+				bestError = error;
+				best = quantized;
+			}
+		}
+		return best;
+	}
+
+	void BlockCompressor::encodeBC6H(const uint16_t* pixels, uint8_t* block)
+	{
+		//Working on the bit patterns rather than the values spreads the error evenly over each power of two, roughly like the eye does
+		BlockChannels channels;
+		channels.channelCount = 3;
+		for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint16_t half = pixels[i * 3 + c];
+				channels.values[c][i] = half & 0x8000 ? 0.0f : std::min(static_cast<float>(half), MAX_HALF);
+			}
+		}
+
+		float endpoints[2][4];
+		fitLine(channels, ALL_TEXELS, MAX_HALF, endpoints[0], endpoints[1]);
+
+		uint32_t best[2][3] = {};
+		uint8_t bestIndices[BLOCK_TEXELS] = {};
+		float bestError = FLT_MAX;
+		for (uint32_t iteration = 0; iteration < REFINE_ITERATIONS; iteration++)
+		{
+			uint32_t quantized[2][3];
+			uint32_t unquantized[2][3];
+			for (uint32_t e = 0; e < 2; e++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					quantized[e][c] = quantizeBC6H(endpoints[e][c]);
+					unquantized[e][c] = unquantizeBC6H(quantized[e][c]);
+				}
+			}
+
+			Palette palette;
+			palette.size = 16;
+			for (uint32_t k = 0; k < 16; k++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					uint32_t interpolated = ((64 - BC7_WEIGHTS4[k]) * unquantized[0][c] + BC7_WEIGHTS4[k] * unquantized[1][c] + 32) >> 6;
+					palette.values[c][k] = static_cast<float>(finishBC6H(interpolated));
+				}
+			}
+
+			uint8_t indices[BLOCK_TEXELS];
+			float errors[BLOCK_TEXELS];
+			float error = selectIndices(channels, palette, indices, errors);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(best, quantized, sizeof(quantized));
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			float weights[BLOCK_TEXELS];
+			weightsFromIndices(indices, BC7_WEIGHTS4, weights);
+			if (!refineEndpoints(channels, ALL_TEXELS, weights, MAX_HALF, endpoints[0], endpoints[1]))
+			{
+				break;
+			}
+		}
+
+		if (bestIndices[0] & 8)
+		{
+			std::swap(best[0], best[1]);
+			for (uint8_t& index : bestIndices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		BitWriter writer(block);
+		writer.write(0x03, 5);
+		for (uint32_t e = 0; e < 2; e++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				writer.write(best[e][c], 10);
+			}
+		}
+		for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			writer.write(bestIndices[i], i == 0 ? 3 : 4);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rub
+{
+	//Encodes single 4x4 blocks into the BCn formats. Every encoder fits endpoints along the block's principal axis and refines them
+	//by least squares, picking indices by searching the whole palette four texels at a time with SSE2 where it's available.
+	//LDR input is 16 RGBA8 texels in row order, HDR input is 16 RGB texels as half float bit patterns
+	class BlockCompressor
+	{
+	public:
+		static constexpr uint32_t BLOCK_TEXELS = 16;
+
+		//Four colour mode only, alpha is ignored
+		static void encodeBC1(const uint8_t* pixels, uint8_t* block);
+		//One channel of the RGBA8 texels
+		static void encodeBC4(const uint8_t* pixels, uint32_t channel, uint8_t* block);
+		//Red and green
+		static void encodeBC5(const uint8_t* pixels, uint8_t* block);
+		//Mode 6 for blocks with alpha, the better of mode 6 and two subset mode 1 for opaque ones
+		static void encodeBC7(const uint8_t* pixels, uint8_t* block);
+		//Unsigned, single region mode 11 with 10 bit endpoints. Negative values have to be clamped to zero beforehand
+		static void encodeBC6H(const uint16_t* pixels, uint8_t* block);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "texture_cooker.hpp"
+#include "../Rubidium Renderer/ktx2_file.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+static void printUsage()
+{
+	std::cout << "Usage: TextureCooker [--type albedo|albedo-bc1|mask|roughness|normal|hdr] [--threads count] <source>..." << std::endl;
+	std::cout << "Writes each source beside itself as a block compressed .ktx2 with a full mip chain." << std::endl;
+	std::cout << "Without --type the type is guessed from each file name." << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	bool hasType = false;
+	rub::TextureCooker::Type type = rub::TextureCooker::Type::Albedo;
+	uint32_t threadCount = std::thread::hardware_concurrency();
+	std::vector<std::string> sources;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--type" && i + 1 < argc)
+		{
+			hasType = rub::TextureCooker::parseType(argv[++i], type);
+			if (!hasType)
+			{
+				printUsage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if (argument == "--threads" && i + 1 < argc)
+		{
+			threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			printUsage();
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			sources.push_back(argument);
+		}
+	}
+
+	if (sources.empty())
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	rub::ThreadPool threadPool(threadCount);
+	rub::TextureCooker cooker(threadPool);
+	bool succeeded = true;
+	for (const std::string& source : sources)
+	{
+		std::string output = rub::Ktx2File::getCookedPath(source);
+		auto start = std::chrono::steady_clock::now();
+		if (!cooker.cook(source, output, hasType ? type : rub::TextureCooker::guessType(source)))
+		{
+			succeeded = false;
+			continue;
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << source << " -> " << output << " (" << elapsed.count() << "ms)" << std::endl;
+	}
+
+	return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
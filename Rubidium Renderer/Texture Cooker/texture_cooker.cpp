@@ -0,0 +1,367 @@
+#include "texture_cooker.hpp"
+
+#include "block_compressor.hpp"
+#include "../Rubidium Renderer/ktx2_file.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../Rubidium Renderer/stb_image.h"
+#define TINYEXR_IMPLEMENTATION
+#include "../Rubidium Renderer/tinyexr.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+namespace rub
+{
+	static constexpr float MAX_HALF_VALUE = 65504.0f;
+
+	static float srgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static float linearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	static uint8_t toUnorm8(float value)
+	{
+		return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+
+	//Round to nearest even, the caller has already clamped to the finite non negative half range
+	static uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+		if (exponent <= 0)
+		{
+			//Subnormal, shift the implicit one in with the mantissa
+			if (exponent < -10)
+			{
+				return 0;
+			}
+			mantissa |= 0x800000;
+			uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t midpoint = 1u << (shift - 1);
+			if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+			{
+				half++;
+			}
+			return static_cast<uint16_t>(half);
+		}
+
+		uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+		uint32_t remainder = mantissa & 0x1FFF;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		{
+			half++;
+		}
+		return static_cast<uint16_t>(std::min(half, 0x7BFFu));
+	}
+
+	TextureCooker::TextureCooker(ThreadPool& threadPool) : threadPool{ threadPool }
+	{
+
+	}
+
+	bool TextureCooker::parseType(const std::string& name, Type& type)
+	{
+		static const std::pair<const char*, Type> TYPE_NAMES[] = {
+			{ "albedo", Type::Albedo },
+			{ "albedo-bc1", Type::AlbedoBC1 },
+			{ "mask", Type::Mask },
+			{ "roughness", Type::Roughness },
+			{ "normal", Type::Normal },
+			{ "hdr", Type::HDR }
+		};
+
+		for (const auto& [typeName, namedType] : TYPE_NAMES)
+		{
+			if (name == typeName)
+			{
+				type = namedType;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	TextureCooker::Type TextureCooker::guessType(const std::string& path)
+	{
+		std::filesystem::path file(path);
+		std::string extension = file.extension().string();
+		std::string name = file.stem().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		if (extension == ".exr" || extension == ".hdr")
+		{
+			return Type::HDR;
+		}
+		if (name.find("normal") != std::string::npos)
+		{
+			return Type::Normal;
+		}
+		if (name.find("mask") != std::string::npos)
+		{
+			return Type::Mask;
+		}
+		if (name.find("roughness") != std::string::npos || name.find("metalness") != std::string::npos)
+		{
+			return Type::Roughness;
+		}
+		return Type::Albedo;
+	}
+
+	uint32_t TextureCooker::getFormat(Type type)
+	{
+		switch (type)
+		{
+		case Type::Albedo:
+			return Ktx2File::BC7_SRGB;
+		case Type::AlbedoBC1:
+			return Ktx2File::BC1_RGB_SRGB;
+		case Type::Roughness:
+			return Ktx2File::BC4_UNORM;
+		case Type::HDR:
+			return Ktx2File::BC6H_UFLOAT;
+		default:
+			return Ktx2File::BC5_UNORM;
+		}
+	}
+
+	bool TextureCooker::cook(const std::string& sourcePath, const std::string& outputPath, Type type)
+	{
+		Image image;
+		if (!load(sourcePath, type, image))
+		{
+			std::cout << "Failed to load texture file " << sourcePath << std::endl;
+			return false;
+		}
+
+		uint32_t width = image.width;
+		uint32_t height = image.height;
+		std::vector<std::vector<uint8_t>> levels;
+		levels.push_back(encode(image, type));
+		while (image.width > 1 || image.height > 1)
+		{
+			image = downsample(image, type);
+			levels.push_back(encode(image, type));
+		}
+
+		if (!Ktx2File::write(outputPath, getFormat(type), width, height, levels))
+		{
+			std::cout << "Failed to write cooked texture " << outputPath << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool TextureCooker::load(const std::string& path, Type type, Image& image)
+	{
+		int width;
+		int height;
+		if (type == Type::HDR)
+		{
+			float* pixels = nullptr;
+			std::string extension = std::filesystem::path(path).extension().string();
+			if (extension == ".exr" || extension == ".EXR")
+			{
+				const char* err = nullptr;
+				if (LoadEXR(&pixels, &width, &height, path.c_str(), &err) != TINYEXR_SUCCESS)
+				{
+					if (err)
+					{
+						std::cout << err << std::endl;
+						FreeEXRErrorMessage(err);
+					}
+					return false;
+				}
+			}
+			else
+			{
+				int channels;
+				pixels = stbi_loadf(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+				if (pixels == nullptr)
+				{
+					return false;
+				}
+			}
+
+			image.width = static_cast<uint32_t>(width);
+			image.height = static_cast<uint32_t>(height);
+			image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+			free(pixels);
+
+			//BC6H is unsigned here, and NaNs and infinities have nowhere to go
+			for (float& value : image.pixels)
+			{
+				value = std::isnan(value) ? 0.0f : std::clamp(value, 0.0f, MAX_HALF_VALUE);
+			}
+			return true;
+		}
+
+		int channels;
+		stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (pixels == nullptr)
+		{
+			return false;
+		}
+
+		image.width = static_cast<uint32_t>(width);
+		image.height = static_cast<uint32_t>(height);
+		image.pixels.resize(static_cast<size_t>(width) * height * 4);
+		for (size_t i = 0; i < image.pixels.size(); i++)
+		{
+			float value = pixels[i] / 255.0f;
+			bool isAlpha = i % 4 == 3;
+			if (!isAlpha && (type == Type::Albedo || type == Type::AlbedoBC1))
+			{
+				value = srgbToLinear(value);
+			}
+			else if (!isAlpha && type == Type::Normal)
+			{
+				value = value * 2.0f - 1.0f;
+			}
+			image.pixels[i] = value;
+		}
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	//2x2 box filter, an odd edge repeats its last texel
+	TextureCooker::Image TextureCooker::downsample(const Image& image, Type type)
+	{
+		Image result;
+		result.width = std::max(image.width / 2, 1u);
+		result.height = std::max(image.height / 2, 1u);
+		result.pixels.resize(static_cast<size_t>(result.width) * result.height * 4);
+
+		for (uint32_t y = 0; y < result.height; y++)
+		{
+			uint32_t y0 = std::min(y * 2, image.height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, image.height - 1);
+			for (uint32_t x = 0; x < result.width; x++)
+			{
+				uint32_t x0 = std::min(x * 2, image.width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, image.width - 1);
+				float* texel = &result.pixels[(static_cast<size_t>(y) * result.width + x) * 4];
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					texel[c] = (image.pixels[(static_cast<size_t>(y0) * image.width + x0) * 4 + c] + image.pixels[(static_cast<size_t>(y0) * image.width + x1) * 4 + c]
+						+ image.pixels[(static_cast<size_t>(y1) * image.width + x0) * 4 + c] + image.pixels[(static_cast<size_t>(y1) * image.width + x1) * 4 + c]) * 0.25f;
+				}
+
+				//Averaged normals come out short, which would darken the lighting on every lower level
+				if (type == Type::Normal)
+				{
+					float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+					if (length > 1e-6f)
+					{
+						texel[0] /= length;
+						texel[1] /= length;
+						texel[2] /= length;
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	std::vector<uint8_t> TextureCooker::encode(const Image& image, Type type)
+	{
+		uint32_t format = getFormat(type);
+		uint32_t blockSize = Ktx2File::getBlockSize(format);
+		uint32_t blocksX = (image.width + 3) / 4;
+		uint32_t blocksY = (image.height + 3) / 4;
+		std::vector<uint8_t> level(static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+		//Converted to the stored encoding once up front, blocks then only gather texels. Blocks past an edge repeat the edge texels
+		std::vector<uint8_t> unorm;
+		std::vector<uint16_t> halves;
+		if (type == Type::HDR)
+		{
+			halves.resize(static_cast<size_t>(image.width) * image.height * 3);
+			for (size_t i = 0; i < static_cast<size_t>(image.width) * image.height; i++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					halves[i * 3 + c] = floatToHalf(image.pixels[i * 4 + c]);
+				}
+			}
+		}
+		else
+		{
+			unorm.resize(image.pixels.size());
+			for (size_t i = 0; i < image.pixels.size(); i++)
+			{
+				float value = image.pixels[i];
+				bool isAlpha = i % 4 == 3;
+				if (!isAlpha && (type == Type::Albedo || type == Type::AlbedoBC1))
+				{
+					value = linearToSrgb(value);
+				}
+				else if (!isAlpha && type == Type::Normal)
+				{
+					value = value * 0.5f + 0.5f;
+				}
+				unorm[i] = toUnorm8(value);
+			}
+		}
+
+		threadPool.parallelFor(blocksY, [&](uint32_t blockY)
+			{
+				uint8_t texels[BlockCompressor::BLOCK_TEXELS * 4];
+				uint16_t hdrTexels[BlockCompressor::BLOCK_TEXELS * 3];
+				for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+				{
+					for (uint32_t i = 0; i < BlockCompressor::BLOCK_TEXELS; i++)
+					{
+						uint32_t x = std::min(blockX * 4 + i % 4, image.width - 1);
+						uint32_t y = std::min(blockY * 4 + i / 4, image.height - 1);
+						size_t texel = static_cast<size_t>(y) * image.width + x;
+						if (type == Type::HDR)
+						{
+							memcpy(&hdrTexels[i * 3], &halves[texel * 3], sizeof(uint16_t) * 3);
+						}
+						else
+						{
+							memcpy(&texels[i * 4], &unorm[texel * 4], 4);
+						}
+					}
+
+					uint8_t* block = &level[(static_cast<size_t>(blockY) * blocksX + blockX) * blockSize];
+					switch (type)
+					{
+					case Type::Albedo:
+						BlockCompressor::encodeBC7(texels, block);
+						break;
+					case Type::AlbedoBC1:
+						BlockCompressor::encodeBC1(texels, block);
+						break;
+					case Type::Roughness:
+						BlockCompressor::encodeBC4(texels, 0, block);
+						break;
+					case Type::HDR:
+						BlockCompressor::encodeBC6H(hdrTexels, block);
+						break;
+					default:
+						BlockCompressor::encodeBC5(texels, block);
+						break;
+					}
+				}
+			});
+		return level;
+	}
+}
\ No newline at end of file
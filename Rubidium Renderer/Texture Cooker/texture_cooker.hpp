@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../Rubidium Renderer/thread_pool.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rub
+{
+	//Turns source images into block compressed KTX2 files with full mip chains, which the renderer loads in place of the source.
+	//Mips are filtered in linear space before each level is encoded, with block rows spread over the thread pool
+	class TextureCooker
+	{
+	public:
+		enum class Type
+		{
+			//sRGB colour as BC7, or BC1 at half the size when the texture has no alpha worth keeping
+			Albedo,
+			AlbedoBC1,
+			//Roughness in red and metalness in green as BC5, the two channels the PBR shader reads
+			Mask,
+			//A single channel as BC4
+			Roughness,
+			//Tangent space XY as BC5, the shader rebuilds Z
+			Normal,
+			//Linear RGB as BC6H
+			HDR
+		};
+
+		TextureCooker(ThreadPool& threadPool);
+
+		static bool parseType(const std::string& name, Type& type);
+		//Guesses from the file extension and the naming the texture sources follow, falling back to albedo
+		static Type guessType(const std::string& path);
+
+		//Returns false after saying why if the source can't be read or the output can't be written
+		bool cook(const std::string& sourcePath, const std::string& outputPath, Type type);
+
+	private:
+		//Linear RGBA, or sRGB decoded to linear for albedo
+		struct Image
+		{
+			uint32_t width;
+			uint32_t height;
+			std::vector<float> pixels;
+		};
+
+		ThreadPool& threadPool;
+
+		static bool load(const std::string& path, Type type, Image& image);
+		static Image downsample(const Image& image, Type type);
+		static uint32_t getFormat(Type type);
+		std::vector<uint8_t> encode(const Image& image, Type type);
+	};
+}
\ No newline at end of file